@@ -0,0 +1,142 @@
+#include "arena.hpp"
+
+#include <sys/mman.h>
+
+#define HUGE_PAGE (2 << 20)
+
+bool Arena::huge_default = false;
+
+Arena::Arena(size_t chunk_size) :
+    top(0), cur(nullptr), end(nullptr), chunk_size(chunk_size), used_bytes(0), huge(huge_default)
+{
+
+}
+
+Arena::~Arena()
+{
+    release();
+}
+
+void Arena::hugepages(bool on)
+{
+    huge_default = on;
+}
+
+void Arena::grow(size_t n)
+{
+    // reuse a chunk kept by rewind()
+    while(!chunks.empty() && top + 1 < chunks.size()) {
+        top++;
+        if(chunks[top].size >= n) {
+            cur = chunks[top].base;
+            end = cur + chunks[top].size;
+            return;
+        }
+    }
+
+    size_t size = chunk_size > n ? chunk_size : n;
+    size_t unit = huge ? HUGE_PAGE : 4096;
+    size = (size + unit - 1) / unit * unit;
+
+    void *p = MAP_FAILED;
+    if(huge) {
+        p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    }
+    if(p == MAP_FAILED) {
+        p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if(p == MAP_FAILED) {
+            throw std::bad_alloc();
+        }
+        if(huge) {
+            madvise(p, size, MADV_HUGEPAGE);
+        }
+    }
+
+    chunks.push_back(Chunk{(char*)p, size});
+    top = chunks.size() - 1;
+    cur = (char*)p;
+    end = cur + size;
+
+    // later chunks double up to 64 MB, so few mappings are needed
+    if(chunk_size < (64 << 20)) {
+        chunk_size *= 2;
+    }
+}
+
+void* Arena::allocate(size_t n, size_t align)
+{
+    uintptr_t p = ((uintptr_t)cur + align - 1) & ~(uintptr_t)(align - 1);
+    if(!cur || p + n > (uintptr_t)end) {
+        grow(n + align);
+        p = ((uintptr_t)cur + align - 1) & ~(uintptr_t)(align - 1);
+    }
+
+    cur = (char*)(p + n);
+    used_bytes += n;
+    return (void*)p;
+}
+
+void Arena::release()
+{
+    for(auto &c : chunks) {
+        munmap(c.base, c.size);
+    }
+    chunks.clear();
+    top = 0;
+    cur = end = nullptr;
+    used_bytes = 0;
+}
+
+Arena::Mark Arena::mark()
+{
+    return Mark{top, cur};
+}
+
+void Arena::rewind(const Mark &m)
+{
+    top = m.chunk;
+    if(top >= chunks.size()) {
+        cur = end = nullptr;
+        return;
+    }
+
+    // without a position, the mark was taken before chunk 'top' was mapped
+    cur = m.cur ? m.cur : chunks[top].base;
+    end = chunks[top].base + chunks[top].size;
+}
+
+void Arena::adopt(Arena &other)
+{
+    // in front of the chunk in use, so rewind() and grow() never hand them out again
+    size_t at = chunks.empty() ? 0 : top;
+    chunks.insert(chunks.begin() + at, other.chunks.begin(), other.chunks.end());
+    if(!chunks.empty() && cur) {
+        top += other.chunks.size();
+    }
+    else {
+        // nothing allocated here yet, start past the adopted chunks
+        top = chunks.size();
+        cur = end = nullptr;
+    }
+    used_bytes += other.used_bytes;
+
+    other.chunks.clear();
+    other.top = 0;
+    other.cur = other.end = nullptr;
+    other.used_bytes = 0;
+}
+
+size_t Arena::used()
+{
+    return used_bytes;
+}
+
+size_t Arena::reserved()
+{
+    size_t r = 0;
+    for(auto &c : chunks) {
+        r += c.size;
+    }
+
+    return r;
+}
@@ -0,0 +1,118 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+/*
+ * Monotonic arena for the scratch data of one phase.
+ *
+ * Memory is carved out of large chunks and never freed one object at a
+ * time; everything goes at once in release() or when the arena is
+ * destroyed. With huge pages on, chunks are 2 MB aligned and mapped with
+ * MAP_HUGETLB, or advised as transparent huge pages when none are
+ * reserved. Not thread safe, each thread needs its own arena.
+ */
+class Arena {
+public:
+    explicit Arena(size_t chunk_size = 1 << 20);
+    ~Arena();
+    Arena(const Arena&)=delete;
+    Arena& operator=(const Arena&)=delete;
+
+    void* allocate(size_t n, size_t align);
+    void release();
+
+    // position to rewind() to, handing out again what was allocated since
+    struct Mark {
+        size_t chunk;
+        char *cur;
+    };
+    Mark mark();
+    void rewind(const Mark &m);
+
+    // take over the chunks of 'other', e.g. the arena of a worker thread,
+    // so they live as long as this one (invalidates marks of both)
+    void adopt(Arena &other);
+
+    // bytes handed out and bytes mapped since the last release()
+    size_t used();
+    size_t reserved();
+
+    // back the chunks of arenas created afterwards with huge pages
+    static void hugepages(bool on);
+
+private:
+    struct Chunk {
+        char *base;
+        size_t size;
+    };
+
+    void grow(size_t n);
+
+    std::vector<Chunk> chunks;
+    size_t top;         // chunk in use, those after it are kept for reuse
+    char *cur;
+    char *end;
+    size_t chunk_size;
+    size_t used_bytes;
+    bool huge;
+
+    static bool huge_default;
+};
+
+/*
+ * Rewinds an arena to where it was when the scope began, for scratch
+ * that lives for one iteration of a loop.
+ */
+class ArenaScope {
+public:
+    explicit ArenaScope(Arena &arena) : arena(arena), m(arena.mark()) {}
+    ~ArenaScope() { arena.rewind(m); }
+    ArenaScope(const ArenaScope&)=delete;
+    ArenaScope& operator=(const ArenaScope&)=delete;
+
+private:
+    Arena &arena;
+    Arena::Mark m;
+};
+
+/*
+ * Allocator for standard containers drawing from an Arena. deallocate()
+ * is a no-op. Without an arena (default constructed) it falls back to
+ * operator new, so containers of this type also work outside a phase.
+ */
+template<class T>
+class ArenaAllocator {
+public:
+    typedef T value_type;
+    // containers moved or swapped keep drawing from the arena they came from
+    typedef std::true_type propagate_on_container_move_assignment;
+    typedef std::true_type propagate_on_container_swap;
+
+    ArenaAllocator() : arena(nullptr) {}
+    ArenaAllocator(Arena *arena) : arena(arena) {}
+    template<class U>
+    ArenaAllocator(const ArenaAllocator<U> &other) : arena(other.arena) {}
+
+    T* allocate(size_t n) {
+        if(!arena) return static_cast<T*>(::operator new(n * sizeof(T)));
+        return static_cast<T*>(arena->allocate(n * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T *p, size_t) {
+        if(!arena) ::operator delete(p);
+    }
+
+    template<class U>
+    bool operator==(const ArenaAllocator<U> &other) const { return arena == other.arena; }
+    template<class U>
+    bool operator!=(const ArenaAllocator<U> &other) const { return arena != other.arena; }
+
+    Arena *arena;
+};
+
+#endif
@@ -2,7 +2,7 @@
 
 static void BuildAlpha(SwitchGraph &sg, SwitchGraphAlpha &alpha, TargetsSet &tss);
 static void BuildBeta(SwitchGraph &sg, SwitchGraphBeta &beta, TargetsSet &tss);
-static void BuildMatrix(SwitchGraph &sg, SwitchGraphMatrix &matrix, TargetsSet &tss, unordered_map<int, int> &s_root);
+static void BuildMatrix(SwitchGraph &sg, SwitchGraphMatrix &matrix, TargetsSet &tss, unordered_map<int, int> &s_pos);
 
 void QuickAssignment(SwitchGraph &sg, TargetsSet &tss, string mode, Assignments &a)
 {
@@ -15,7 +15,7 @@ void QuickAssignment(SwitchGraph &sg, TargetsSet &tss, string mode, Assignments
 
 #ifdef DEBUG
     printf("[ ] targets and reporters set as below:\n");
-    for(auto ts : tss) {
+    for(auto &ts : tss) {
         printf("    -");
         for(auto s : ts) {
             printf(" %d", s);
@@ -29,25 +29,23 @@ void QuickAssignment(SwitchGraph &sg, TargetsSet &tss, string mode, Assignments
 #endif
 }
 
-void ReportHeaderAssignment(SwitchGraph &sg, RuleGraph &rg, PathSet &ps, string mode, Assignments &a)
+void ReportHeaderAssignment(SwitchGraph &sg, const RuleGraph &rg, PathSet &ps, string mode, Assignments &a)
 {
     TargetsSet tss;
-    for(auto p : ps) {
+    for(auto &p : ps) {
         // targets derived from tested path
-        vector<int> targets = GetTargets(rg, p);
-        tss.insert(targets);
+        tss.insert(GetTargets(rg, p));
     }
     
-    for(auto it : sg) {
+    for(auto &it : sg) {
         int s = it.first;
         // single switch as targets
-        vector<int> targets = {s};
-        tss.insert(targets);
+        tss.insert(vector<int>{s});
     }
 
 #ifdef DEBUG
     printf("[ ] targets and reporters set as below:\n");
-    for(auto ts : tss) {
+    for(auto &ts : tss) {
         printf("    -");
         for(auto s : ts) {
             printf(" %d", s);
@@ -82,7 +80,7 @@ void ReportHeaderAssignment(SwitchGraph &sg, RuleGraph &rg, PathSet &ps, string
 #ifdef DEBUG
     printf("[!] %d bits required for report header\n", a[SID_OF_MASKLEN].first);
     printf("    switch report headers as below:\n");
-    for(auto it : a) {
+    for(auto &it : a) {
         int s = it.first;
         if(s != SID_OF_MASKLEN) {
             printf("    - %d - (%d, %d)\n", s, a[s].first, a[s].second);
@@ -95,7 +93,7 @@ void ReportHeaderAssignment(SwitchGraph &sg, RuleGraph &rg, PathSet &ps, string
 void SimpleAssignment(SwitchGraph &sg, Assignments &a)
 {
     int maskbit = 0;
-    for(auto it : sg) {
+    for(auto &it : sg) {
         int s = it.first;
         a[s] = make_pair(maskbit, 1);
         maskbit++;
@@ -116,7 +114,7 @@ void GreedyColoringAssignment(SwitchGraph &sg, TargetsSet &tss, Assignments &a)
     GreedyColoring(alpha, coloring);
 
     int cmax = -1;
-    for(auto it : coloring) {
+    for(auto &it : coloring) {
         int color = it.first;
         cmax = (cmax < color) ? color : cmax;
         for(auto s : coloring.at(color)) {
@@ -149,7 +147,7 @@ void CompactColoringAssignment(SwitchGraph &sg, TargetsSet &tss, bool opt, Assig
         GreedyCompactColoring(alpha, beta, coloring);
     }
     int cmax = -1;
-    for(auto it : coloring) {
+    for(auto &it : coloring) {
         Color color = it.first;
         cmax = (cmax < color.first) ? color.first : cmax;
         for(auto s : coloring.at(color)) {
@@ -161,7 +159,7 @@ void CompactColoringAssignment(SwitchGraph &sg, TargetsSet &tss, bool opt, Assig
 
 #ifdef DEBUG
     printf("[ ] compact coloring as below:\n");
-    for(auto it : coloring) {
+    for(auto &it : coloring) {
         printf("    -");
         for(auto s : coloring.at(it.first)) {
             printf(" %d", s);
@@ -186,8 +184,6 @@ void CompactColoringAssignment(SwitchGraph &sg, TargetsSet &tss, bool opt, Assig
  */
 void TwoPhaseAssignment(SwitchGraph &sg, TargetsSet &tss, Assignments &a)
 {
-    int n = sg.size();
-
     /* Merge phase */ 
 
     // step 1: build alpha
@@ -201,7 +197,7 @@ void TwoPhaseAssignment(SwitchGraph &sg, TargetsSet &tss, Assignments &a)
     // step 3: merge
     unordered_map<int, int> s_root;
     vector<int> s_remained;
-    for(auto it : coloring) {
+    for(auto &it : coloring) {
         int c = it.first;
         // the first one as a representative
         int root = coloring.at(c)[0];
@@ -214,7 +210,7 @@ void TwoPhaseAssignment(SwitchGraph &sg, TargetsSet &tss, Assignments &a)
    
 #ifdef DEBUG
     printf("[ ] merge phase (coloring) as below:\n");
-    for(auto it : coloring) {
+    for(auto &it : coloring) {
         printf("    -");
         for(auto s : coloring.at(it.first)) {
             printf(" %d", s);
@@ -225,17 +221,40 @@ void TwoPhaseAssignment(SwitchGraph &sg, TargetsSet &tss, Assignments &a)
 
     /* Match phase */
 
-    // step 1: build matrix as beta's complement 
-    SwitchGraphMatrix matrix;
-    BuildMatrix(sg, matrix, tss, s_root);
-
-    // step 2: maximum matching
-    unordered_map<int, int> match;
+    // step 1: build matrix as beta's complement, only over representatives
+    // which are numbered in the order of their sidx
     vector<int> remained;
     for(auto s : s_remained) {
         remained.push_back(sg.at(s).getSIdx());
     }
-    Edmonds(matrix, n, remained, match);
+    vector<int> pos_idx(remained.begin(), remained.end());     // pos -> sidx
+    sort(pos_idx.begin(), pos_idx.end());
+    unordered_map<int, int> idx_pos;                            // sidx -> pos
+    for(size_t pos = 0; pos < pos_idx.size(); pos++) {
+        idx_pos[pos_idx[pos]] = pos;
+    }
+    unordered_map<int, int> s_pos;                              // sid -> pos of its root
+    for(auto &it : s_root) {
+        s_pos[it.first] = idx_pos[sg.at(it.second).getSIdx()];
+    }
+
+    SwitchGraphMatrix matrix(remained.size());
+    BuildMatrix(sg, matrix, tss, s_pos);
+
+    // step 2: maximum matching
+    vector<int> vertices;
+    for(auto idx : remained) {
+        vertices.push_back(idx_pos[idx]);
+    }
+    vector<int> mate;
+    Edmonds(matrix, vertices, mate);
+
+    unordered_map<int, int> match;      // sidx -> sidx, recorded once
+    for(size_t pos = 0; pos < mate.size(); pos++) {
+        if(mate[pos] > (int)pos) {
+            match[pos_idx[pos]] = pos_idx[mate[pos]];
+        }
+    }
 
 #ifdef DEBUG
     printf("[ ] match phase (maximum matching) as below:\n");
@@ -248,7 +267,7 @@ void TwoPhaseAssignment(SwitchGraph &sg, TargetsSet &tss, Assignments &a)
             printf(" %d#%d", s, sg.at(s).getSIdx());
         }
         printf("\n");
-        for(auto it : match) {
+        for(auto &it : match) {
             printf("    - #%d - #%d\n", it.first, it.second);
         }
     }
@@ -265,7 +284,7 @@ void TwoPhaseAssignment(SwitchGraph &sg, TargetsSet &tss, Assignments &a)
     Assignments aidx;       // assign to 'remained' idx first
 
     set<int> matched;       // a subset of 'remained'
-    for(auto it : match) {
+    for(auto &it : match) {
         int idx = it.first;
         // for matched idx
         aidx[idx] = make_pair(maskbit, 1);
@@ -285,7 +304,7 @@ void TwoPhaseAssignment(SwitchGraph &sg, TargetsSet &tss, Assignments &a)
     }
 
     // for sid (merged vertices is handled here) 
-    for(auto it : sg) {
+    for(auto &it : sg) {
         int s = it.first;
         a[s] = aidx[sg.at(s_root[s]).getSIdx()];
     }
@@ -295,8 +314,10 @@ void TwoPhaseAssignment(SwitchGraph &sg, TargetsSet &tss, Assignments &a)
 
 void BuildAlpha(SwitchGraph &sg, SwitchGraphAlpha &alpha, TargetsSet &tss)
 {
-    for(auto targets : tss) {
-        set<int> reporters = GetReporters(sg, targets);
+    Arena arena;
+    for(auto &targets : tss) {
+        ArenaScope scope(arena);
+        ReporterSet reporters = GetReporters(sg, targets, &arena);
         
         // two vertices can't be identical iff
         // one is the target and the other is its reporter 
@@ -310,7 +331,7 @@ void BuildAlpha(SwitchGraph &sg, SwitchGraphAlpha &alpha, TargetsSet &tss)
 
 #ifdef DEBUG
     printf("[ ] graph alpha as below:\n");
-    for(auto it : alpha) {
+    for(auto &it : alpha) {
         int s1 = it.first;
         printf("    - %d -", s1);
         for(auto s2 : alpha[s1]) {
@@ -323,7 +344,9 @@ void BuildAlpha(SwitchGraph &sg, SwitchGraphAlpha &alpha, TargetsSet &tss)
 
 void BuildBeta(SwitchGraph &sg, SwitchGraphBeta &beta, TargetsSet &tss)
 {
-    for(auto targets : tss) {
+    Arena arena;
+    for(auto &targets : tss) {
+        ArenaScope scope(arena);
         // two vertices can't be cooperative iff in two cases
         
         // case 1: they are in the same target set
@@ -335,7 +358,7 @@ void BuildBeta(SwitchGraph &sg, SwitchGraphBeta &beta, TargetsSet &tss)
         }
 
         // case 2: they are in the same reporter set 
-        set<int> reporters = GetReporters(sg, targets);
+        ReporterSet reporters = GetReporters(sg, targets, &arena);
         for(auto s1 : reporters) {
             for(auto s2 : reporters) {
                 beta[s1].insert(s2);
@@ -350,7 +373,7 @@ void BuildBeta(SwitchGraph &sg, SwitchGraphBeta &beta, TargetsSet &tss)
     if(beta.size() == 0) {
         printf("    - beta is empty\n");
     }
-    for(auto it : beta) {
+    for(auto &it : beta) {
         int s1 = it.first;
         printf("    - %d -", s1);
         for(auto s2 : beta[s1]) {
@@ -361,56 +384,53 @@ void BuildBeta(SwitchGraph &sg, SwitchGraphBeta &beta, TargetsSet &tss)
 #endif
 }
 
-void BuildMatrix(SwitchGraph &sg, SwitchGraphMatrix &matrix, TargetsSet &tss, unordered_map<int, int> &s_root)
+void BuildMatrix(SwitchGraph &sg, SwitchGraphMatrix &matrix, TargetsSet &tss, unordered_map<int, int> &s_pos)
 {
-    for(auto it1 : sg) {
-        for(auto it2 : sg) {
-            int s1 = it1.first;
-            int s2 = it2.first;
-            int idx1 = sg.at(s_root[s1]).getSIdx();
-            int idx2 = sg.at(s_root[s2]).getSIdx();
-            if(idx1 != idx2) {
-                matrix[idx1][idx2] = matrix[idx2][idx1] = 1;
-            }
+    int n = matrix.size();
+    for(int pos1 = 0; pos1 < n; pos1++) {
+        for(int pos2 = 0; pos2 < n; pos2++) {
+            matrix.set(pos1, pos2, pos1 != pos2);
         }
     }
 
-    for(auto targets : tss) {
+    Arena arena;
+    for(auto &targets : tss) {
+        ArenaScope scope(arena);
         // two vertices can't be cooperative iff in two cases
         
         // case 1: they are in the same target set
         for(auto s1 : targets) {
             for(auto s2 : targets) {
-                int idx1 = sg.at(s_root[s1]).getSIdx();
-                int idx2 = sg.at(s_root[s2]).getSIdx();
-                matrix[idx1][idx2] = matrix[idx2][idx1] = 0;
+                int pos1 = s_pos.at(s1);
+                int pos2 = s_pos.at(s2);
+                matrix.set(pos1, pos2, 0);
+                matrix.set(pos2, pos1, 0);
             }
         }
 
         // case 2: they are in the same reporter set 
-        set<int> reporters = GetReporters(sg, targets);
+        ReporterSet reporters = GetReporters(sg, targets, &arena);
         for(auto s1 : reporters) {
             for(auto s2 : reporters) {
-                int idx1 = sg.at(s_root[s1]).getSIdx();
-                int idx2 = sg.at(s_root[s2]).getSIdx();
-                matrix[idx1][idx2] = matrix[idx2][idx1] = 0;
+                int pos1 = s_pos.at(s1);
+                int pos2 = s_pos.at(s2);
+                matrix.set(pos1, pos2, 0);
+                matrix.set(pos2, pos1, 0);
             }
         }
     }
 
 #ifdef DEBUG
     printf("[ ] graph matrix as below:\n");
-    int n = sg.size();
     printf("    -");
-    for(auto it : sg) {
-        int s = it.first;
-        printf(" %d#%d", s, sg.at(s).getSIdx());
+    for(auto &it : s_pos) {
+        printf(" %d#%d", it.first, it.second);
     }
     printf("\n");
-    for(int idx1 = 0; idx1 < n; idx1++) {
+    for(int pos1 = 0; pos1 < n; pos1++) {
         printf("    -");
-        for(int idx2 = 0; idx2 < n; idx2++) {
-            printf(" %d", matrix[idx1][idx2]);
+        for(int pos2 = 0; pos2 < n; pos2++) {
+            printf(" %d", matrix.get(pos1, pos2));
         }
         printf("\n");
     }
@@ -0,0 +1,733 @@
+#include "core.hpp"
+
+#include "unistd.h"
+#include "stdlib.h"
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <thread>
+
+void usage()
+{
+    printf("[-] Usage: ./benchmark -m <mode> [-n <size>] [-f <topofile>]\n"
+           "[ ] <mode>: hsa|translate|edges|twophase|chains|warmstart|parallel|incremental|allocs\n"
+           "[ ] <size>: number of headers (hsa), prefixes (translate), rules per switch (edges), switches (twophase),\n"
+           "[ ]         rules per chain (chains)\n"
+           "[ ]         or path length threshold (warmstart, parallel, incremental, allocs)\n"
+           "[ ] <topofile>: filename under /data/topo/ (warmstart, parallel, incremental, allocs)\n");
+}
+
+// heap allocations made by the whole binary, for mode allocs
+static atomic<long> allocations(0);
+
+void* operator new(size_t n)
+{
+    allocations.fetch_add(1, memory_order_relaxed);
+    void *p = malloc(n ? n : 1);
+    if(!p) throw bad_alloc();
+    return p;
+}
+
+void operator delete(void *p) noexcept
+{
+    free(p);
+}
+
+void operator delete(void *p, size_t) noexcept
+{
+    free(p);
+}
+
+static double now()
+{
+    return chrono::duration<double, milli>(chrono::high_resolution_clock::now().time_since_epoch()).count();
+}
+
+// a random prefix under 10.0.0.0/8 whose length is in [8, 32]
+static Header RandomPrefix(mt19937 &gen)
+{
+    char buf[32];
+    snprintf(buf, sizeof(buf), "10.%u.%u.%u/%u", (unsigned)gen() % 4, (unsigned)gen() % 4, (unsigned)gen() % 256, 8 + (unsigned)gen() % 25);
+    return HSA::translate(buf);
+}
+
+// matchability as computed before the word-parallel test: one digit at a time
+static bool DigitMatchable(const Header &a, const Header &b)
+{
+    Header c = HSA::intersection(a, b);
+    for(size_t ith = 0; ith < c.size(); ith++) {
+        if(HSA::get(c, ith) == '-') {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/* one header against n candidates, per-digit vs word-parallel vs batch kernels */
+void hsa(int n)
+{
+    mt19937 gen(49);
+    vector<Header> as, bs;
+    for(int i = 0; i < n; i++) {
+        as.push_back(RandomPrefix(gen));
+        bs.push_back(RandomPrefix(gen));
+    }
+    double checks = double(n) * n;
+
+    double st = now();
+    long hits = 0;
+    for(auto &a : as) {
+        for(auto &b : bs) {
+            hits += DigitMatchable(a, b);
+        }
+    }
+    double base = now() - st;
+    printf("[ ] %-8s %8.2f ns/check (%ld matches)\n", "digit", base * 1e6 / checks, hits);
+
+    st = now();
+    hits = 0;
+    for(auto &a : as) {
+        for(auto &b : bs) {
+            hits += HSA::matchable(a, b);
+        }
+    }
+    double drt = now() - st;
+    printf("[ ] %-8s %8.2f ns/check (%ld matches) x%.1f\n", "word", drt * 1e6 / checks, hits, base / drt);
+
+    vector<Prefix> ap(n), bp(n);
+    for(int i = 0; i < n; i++) {
+        HSA::toPrefix(as[i], ap[i]);
+        HSA::toPrefix(bs[i], bp[i]);
+    }
+
+    st = now();
+    hits = 0;
+    for(auto &a : ap) {
+        for(auto &b : bp) {
+            hits += HSA::matchable(a, b);
+        }
+    }
+    drt = now() - st;
+    printf("[ ] %-8s %8.2f ns/check (%ld matches) x%.1f\n", "prefix", drt * 1e6 / checks, hits, base / drt);
+
+    vector<uint64_t> mask((n + 63) / 64);
+    for(string isa : {"scalar", "avx2", "avx512"}) {
+        HSA::MatchKernel k = HSA::kernel(isa);
+        if(!k) {
+            printf("[ ] %-8s unsupported\n", isa.c_str());
+            continue;
+        }
+
+        st = now();
+        hits = 0;
+        for(auto &a : as) {
+            k(a, bs.data(), bs.size(), mask.data());
+            for(auto m : mask) {
+                hits += __builtin_popcountll(m);
+            }
+        }
+        drt = now() - st;
+        printf("[ ] %-8s %8.2f ns/check (%ld matches) x%.1f\n", isa.c_str(), drt * 1e6 / checks, hits, base / drt);
+    }
+}
+
+// HSA::translate as it used to be, building substrings and a binary string
+static Header LegacyTranslate(const string &prefix)
+{
+    string ip;
+    int mask_l;
+    size_t pos = prefix.find('/');
+
+    if(pos == string::npos) {
+        ip = prefix;
+        mask_l = 32;
+    }
+    else {
+        ip = prefix.substr(0, pos);
+        mask_l = stoi(prefix.substr(pos + 1));
+    }
+
+    string binstr;
+    ip += '.';
+    do {
+        pos = ip.find('.');
+        int part = stoi(ip.substr(0, pos));
+        for(int ct = 0; ct < 8; ct++) {
+            binstr += (part >> (7-ct) & 1) ? '1' : '0';
+        }
+        ip = ip.substr(pos + 1);
+    } while(ip != "");
+
+    Header header;
+    for(int ith = 0; ith < HEADER_BITS; ith++) {
+        char ch = (ith < (32-mask_l) || ith >= 32) ? 'x' : binstr[31-ith];
+        HSA::set(header, ith, ch);
+    }
+
+    return header;
+}
+
+/* prefix parsing throughput, legacy vs in-place vs bulk */
+void translate(int n)
+{
+    mt19937 gen(49);
+    vector<string> prefixes;
+    for(int i = 0; i < n; i++) {
+        char buf[32];
+        snprintf(buf, sizeof(buf), "10.%u.%u.%u/%u", (unsigned)gen() % 256, (unsigned)gen() % 256, (unsigned)gen() % 256, (unsigned)gen() % 33);
+        prefixes.push_back(buf);
+    }
+
+    double st = now();
+    vector<Header> legacy;
+    for(auto &p : prefixes) {
+        legacy.push_back(LegacyTranslate(p));
+    }
+    double base = now() - st;
+    printf("[ ] %-8s %8.2f M prefixes/s\n", "legacy", n / base / 1e3);
+
+    st = now();
+    vector<Header> single(n);
+    for(int i = 0; i < n; i++) {
+        single[i] = HSA::translate(prefixes[i]);
+    }
+    double drt = now() - st;
+    printf("[ ] %-8s %8.2f M prefixes/s x%.1f\n", "single", n / drt / 1e3, base / drt);
+
+    st = now();
+    vector<Header> bulk;
+    HSA::translate(prefixes, bulk);
+    drt = now() - st;
+    printf("[ ] %-8s %8.2f M prefixes/s x%.1f\n", "bulk", n / drt / 1e3, base / drt);
+
+    if(single != legacy || bulk != legacy) {
+        throw "translate() differs from the legacy parser.";
+    }
+
+    if(HEADER_BITS >= 128) {
+        vector<string> v6;
+        for(int i = 0; i < n; i++) {
+            char buf[64];
+            snprintf(buf, sizeof(buf), "2001:db8:%x:%x::%x/%u", (unsigned)gen() % 65536, (unsigned)gen() % 65536, (unsigned)gen() % 65536, (unsigned)gen() % 129);
+            v6.push_back(buf);
+        }
+
+        st = now();
+        HSA::translate(v6, bulk);
+        drt = now() - st;
+        printf("[ ] %-8s %8.2f M prefixes/s\n", "ipv6", n / drt / 1e3);
+    }
+}
+
+/* rule graph edge building between two switches, pairwise scan vs IO::BuildRuleGraph */
+void edges(int n)
+{
+    for(int r = 256; r <= n; r *= 4) {
+        mt19937 gen(49);
+        SwitchGraph sg;
+        RuleGraph rg;
+        sg[1] = SwitchNode(1, 0);
+        sg[2] = SwitchNode(2, 1);
+        sg[1].addNeighbor(2);
+        sg[2].addNeighbor(1);
+        for(int i = 0; i < 2 * r; i++) {
+            char buf[32];
+            snprintf(buf, sizeof(buf), "10.%u.%u.%u/%u", (unsigned)gen() % 16, (unsigned)gen() % 256, (unsigned)gen() % 256, 12 + (unsigned)gen() % 21);
+            int sid = (i < r) ? 1 : 2;
+            // s1 forwards everything to s2, s2 takes everything from s1
+            rg[i] = (sid == 1) ? RuleNode(i, 1, buf, 0, 2, 0) : RuleNode(i, 2, buf, 1, 0, 0);
+            sg[sid].addRule(i);
+        }
+
+        double st = now();
+        long pairwise = 0;
+        for(auto r1 : sg[1].getRules()) {
+            Header h1 = rg[r1].getRule().getOutHeader();
+            for(auto r2 : sg[2].getRules()) {
+                pairwise += HSA::matchable(h1, rg[r2].getRule().getInHeader());
+            }
+        }
+        double base = now() - st;
+
+        st = now();
+        IO::BuildRuleGraph(sg, rg);
+        double drt = now() - st;
+
+        long built = 0;
+        for(auto &it : rg) {
+            built += it.second.getNexts().size();
+        }
+        if(built != pairwise) {
+            throw "BuildRuleGraph() differs from the pairwise scan.";
+        }
+
+        printf("[ ] %6d rules/switch: pairwise %9.2f ms, built %8.2f ms x%.1f (%ld edges)\n", r, base, drt, base / drt, built);
+    }
+}
+
+/* two-phase assignment on random sparse switch graphs of 1000 up to n switches */
+void twophase(int n)
+{
+    for(int ns = 1000; ns <= n; ns *= 5) {
+        mt19937 gen(49);
+        SwitchGraph sg;
+        for(int s = 0; s < ns; s++) {
+            sg[s] = SwitchNode(s, s);
+        }
+        // a random tree plus ns / 2 extra links
+        auto link = [&](int u, int v) {
+            sg[u].addNeighbor(v);
+            sg[v].addNeighbor(u);
+        };
+        for(int s = 1; s < ns; s++) {
+            link(s, gen() % s);
+        }
+        for(int e = 0; e < ns / 2; e++) {
+            int u = gen() % ns, v = gen() % ns;
+            if(u != v) link(u, v);
+        }
+
+        // random walks of 2 to 6 switches, and every switch alone
+        TargetsSet tss;
+        for(int s = 0; s < ns; s++) {
+            tss.insert(vector<int>{s});
+            vector<int> walk = {s};
+            for(int len = 2 + gen() % 5; (int)walk.size() < len; ) {
+                vector<int> &nbrs = sg[walk.back()].getNeighbors();
+                int next = nbrs[gen() % nbrs.size()];
+                if(find(walk.begin(), walk.end(), next) != walk.end()) break;
+                walk.push_back(next);
+            }
+            tss.insert(walk);
+        }
+
+        double st = now();
+        Assignments a;
+        TwoPhaseAssignment(sg, tss, a);
+        double drt = now() - st;
+        printf("[ ] %6d switches: %9.2f ms, %d bits\n", ns, drt, a[SID_OF_MASKLEN].first);
+    }
+}
+
+// Hopcroft-Karp as it used to be, with a recursive augmenting search
+struct LegacyHopcroftKarp {
+    const DenseRuleGraph &g;
+    int dist;
+    vector<int> d, vis, cx, cy;
+    vector<int> in_header, out_header;
+    int epoch = 0;
+    int depth = 0, max_depth = 0;
+
+    explicit LegacyHopcroftKarp(const DenseRuleGraph &g) :
+        g(g), d(g.size(), 0), vis(g.size(), 0), cx(g.size(), -1), cy(g.size(), -1)
+    {
+        for(int r = 0; r < g.size(); r++) {
+            in_header.push_back(g.getInHeaderId(r));
+            out_header.push_back(g.getOutHeaderId(r));
+        }
+    }
+
+    bool bfs()
+    {
+        queue<int> q;
+        for(int u = 0; u < g.size(); u++) {
+            d[u] = (cx[u] == -1) ? 0 : INF;
+            if(cx[u] == -1) q.push(u);
+        }
+        dist = INF;
+        while(!q.empty()) {
+            int u = q.front();
+            q.pop();
+            if(d[u] >= dist) break;
+            for(auto v : g.getNexts(u)) {
+                if(!HeaderPool::instance().matchable(out_header[u], in_header[v])) continue;
+                if(cy[v] == -1 && dist == INF) {
+                    dist = d[u] + 1;
+                }
+                else if(cy[v] != -1 && d[cy[v]] == INF) {
+                    d[cy[v]] = d[u] + 1;
+                    q.push(cy[v]);
+                }
+            }
+        }
+        return dist != INF;
+    }
+
+    bool dfs(int src)
+    {
+        max_depth = max(max_depth, ++depth);
+        for(auto v : g.getNexts(src)) {
+            if(vis[v] == epoch) continue;
+            if(!HeaderPool::instance().matchable(out_header[src], in_header[v])) continue;
+            vis[v] = epoch;
+            if(cy[v] == -1 && dist != d[src] + 1) continue;
+            if(cy[v] != -1 && d[cy[v]] != d[src] + 1) continue;
+            if(cy[v] != -1 && d[cy[v]] == dist) continue;
+            if(cy[v] == -1 || dfs(cy[v])) {
+                in_header[v] = HeaderPool::instance().intersection(out_header[src], g.getInHeaderId(v));
+                out_header[v] = g.getAvailableOutHeaderId(v, in_header[v]);
+                cx[src] = v;
+                cy[v] = src;
+                depth--;
+                return true;
+            }
+        }
+        depth--;
+        return false;
+    }
+
+    int run()
+    {
+        int phases = 0;
+        while(bfs()) {
+            phases++;
+            for(int src = 0; src < g.size(); src++) {
+                if(cx[src] == -1) {
+                    epoch++;
+                    dfs(src);
+                }
+            }
+        }
+        return phases;
+    }
+};
+
+/* Hopcroft-Karp on chains of 1000 up to n rules whose last phase augments along the whole chain */
+void chains(int n)
+{
+    for(int len = 1000; len <= n; len *= 10) {
+        // x rules x0..xL and y rules y0..yL with edges x0 -> y0, xi -> y(i-1) and xi -> yi,
+        // rules get their roles by index, x1..xL first so they take y0..y(L-1) in the first
+        // phase and leave x0 to shift them all in the second
+        RuleGraph rg;
+        rg.reserve(2 * (len + 1));
+        for(int r = 0; r < 2 * (len + 1); r++) {
+            rg.emplace(r, RuleNode(r, 1, "10.0.0.0/8", 1, 2, 0));
+        }
+        vector<int> rids;
+        DenseRuleGraph order(rg);
+        for(int i = 0; i < order.size(); i++) {
+            rids.push_back(order.getRID(i));
+        }
+        auto x = [&](int i) { return rids[i == 0 ? len : i - 1]; };
+        auto y = [&](int i) { return rids[len + 1 + i]; };
+        rg[x(0)].addNext(y(0));
+        for(int i = 1; i <= len; i++) {
+            rg[x(i)].addNext(y(i - 1));
+            rg[x(i)].addNext(y(i));
+        }
+        DenseRuleGraph g(rg);
+
+        double st = now();
+        HopcroftKarpMatcher hk;
+        vector<int> match;
+        hk.run(g, match);
+        double drt = now() - st;
+        printf("[ ] %8d rules: iterative %9.2f ms in %d phases, %8.2f ms/phase\n", len, drt, hk.phases(), drt / hk.phases());
+
+        // a recursion as deep as the chain may overflow the stack
+        if(len > 100000) {
+            printf("[ ] %8d rules: recursive skipped\n", len);
+            continue;
+        }
+        st = now();
+        LegacyHopcroftKarp legacy(g);
+        int phases = legacy.run();
+        double base = now() - st;
+        printf("[ ] %8d rules: recursive %9.2f ms in %d phases, %8.2f ms/phase, %d frames deep x%.1f\n",
+               len, base, phases, base / phases, legacy.max_depth, base / drt);
+        if(legacy.cx != match) {
+            throw "HopcroftKarpMatcher differs from the recursive search.";
+        }
+    }
+}
+
+/* Hopcroft-Karp from an empty matching vs from a Karp-Sipser one, in path cover with threshold 'plt' */
+void warmstart(string name, unsigned plt)
+{
+    SwitchGraph sg;
+    RuleGraph rg;
+    IO::instance().LoadTopo(name, sg, rg);
+    int depth = (plt == (unsigned)INF) ? 0 : plt;
+
+    double st = now();
+    PathSet ps;
+    PathCover(rg, ps, "hopcroft-karp", depth);
+    double cover = now() - st;
+    printf("[ ] %s: %zu rules, path cover %.2f ms, %zu paths\n", name.c_str(), rg.size(), cover, ps.size());
+
+    // the closure path cover matches on
+    Arena arena;
+    DenseRuleGraph g(rg);
+    vector<int> topoorder;
+    TopoSort(g, topoorder);
+    DenseRuleGraph closure;
+    TransClosure(g, topoorder, depth, closure, arena);
+
+    double base = 0;
+    for(bool warm : {false, true}) {
+        HopcroftKarpMatcher hk(warm);
+        vector<int> match;
+        double drt = INF;
+        for(int rep = 0; rep < 5; rep++) {
+            st = now();
+            hk.run(closure, match);
+            drt = min(drt, now() - st);
+        }
+        int matched = g.size() - count(match.begin(), match.end(), -1);
+        if(!warm) base = drt;
+        printf("[ ] %-5s %8.2f ms (%4.1f%% of path cover) in %d phases, %d of %d matched by the warm start x%.1f\n",
+               warm ? "warm" : "cold", drt, 100 * drt / cover, hk.phases(), hk.warmed(), matched, base / drt);
+    }
+}
+
+/* Hopcroft-Karp on one thread vs on pools of 1 up to the cores, in path cover with threshold 'plt' */
+void parallel(string name, unsigned plt)
+{
+    SwitchGraph sg;
+    RuleGraph rg;
+    IO::instance().LoadTopo(name, sg, rg);
+    int depth = (plt == (unsigned)INF) ? 0 : plt;
+
+    // the closure path cover matches on
+    Arena arena;
+    DenseRuleGraph g(rg);
+    vector<int> topoorder;
+    TopoSort(g, topoorder);
+    DenseRuleGraph closure;
+    TransClosure(g, topoorder, depth, closure, arena);
+    printf("[ ] %s: %zu rules, %zu closure edges\n", name.c_str(), rg.size(), closure.edges());
+
+    ThreadPool &pool = ThreadPool::instance();
+    int threads = pool.size();
+    int cores = max(4, (int)thread::hardware_concurrency());
+
+    vector<int> match;
+    HopcroftKarpMatcher hk;
+    double base = INF;
+    for(int rep = 0; rep < 5; rep++) {
+        double st = now();
+        hk.run(closure, match);
+        base = min(base, now() - st);
+    }
+    int matched = g.size() - count(match.begin(), match.end(), -1);
+    printf("[ ] %-12s %8.2f ms in %2d phases, %d matched\n", "sequential", base, hk.phases(), matched);
+
+    for(int t = 1; t <= cores; t *= 2) {
+        pool.resize(t);
+        ParallelHopcroftKarpMatcher phk;
+        double drt = INF;
+        for(int rep = 0; rep < 5; rep++) {
+            double st = now();
+            phk.run(closure, match);
+            drt = min(drt, now() - st);
+        }
+        int found = g.size() - count(match.begin(), match.end(), -1);
+        if(found != matched) {
+            throw "ParallelHopcroftKarpMatcher matches fewer rules. parallel() exits.";
+        }
+        printf("[ ] %2d threads   %8.2f ms in %2d phases x%.2f\n", t, drt, phk.phases(), base / drt);
+    }
+    pool.resize(threads);
+}
+
+/* incremental path cover vs from scratch, as rules and edges are taken out and put back, with path length threshold 'plt' */
+void incremental(string name, unsigned plt)
+{
+    SwitchGraph sg;
+    RuleGraph rg;
+    IO::instance().LoadTopo(name, sg, rg);
+    int depth = (plt == (unsigned)INF) ? 0 : plt;
+
+    IncrementalPathCover inc(depth);
+    PathSet ps;
+    double st = now();
+    inc.build(rg, ps);
+    printf("[ ] %s: %zu rules, build %.2f ms, %zu paths\n", name.c_str(), rg.size(), now() - st, ps.size());
+
+    vector<int> rids;
+    for(auto &it : rg) {
+        rids.push_back(it.first);
+    }
+    sort(rids.begin(), rids.end());
+    mt19937 gen(11);
+
+    auto step = [&](int k, const char *what, const RuleGraphDelta &delta) {
+        double st = now();
+        inc.update(rg, delta, ps);
+        double drt = now() - st;
+
+        PathSet ps2;
+        IncrementalPathCover scratch(depth);
+        st = now();
+        scratch.build(rg, ps2);
+        double base = now() - st;
+        if(ps.size() != ps2.size()) {
+            throw "IncrementalPathCover::update() differs in path count from build(). incremental() exits.";
+        }
+        for(auto &path : ps) {
+            for(size_t i = 1; i < path.size(); i++) {
+                auto it = rg.find(path[i - 1]);
+                if(it == rg.end() || find(it->second.getNexts().begin(), it->second.getNexts().end(), path[i]) == it->second.getNexts().end()) {
+                    throw "IncrementalPathCover::update() gives a path off the rule graph. incremental() exits.";
+                }
+            }
+        }
+        printf("[ ] %4d %-11s %8.2f ms (%8.2f ms from scratch x%5.1f), %5d rules walked, %3d pairs dropped, %3d paths augmented, %zu paths (%zu)\n",
+               k, what, drt, base, base / drt, inc.walked(), inc.dropped(), inc.augmented(), ps.size(), ps2.size());
+    };
+
+    for(int k : {1, 10, 100}) {
+        // 'k' edges out and back in
+        RuleGraphDelta out, in;
+        for(int i = 0; i < k; i++) {
+            int rid = rids[gen() % rids.size()];
+            vector<int> &nexts = rg.at(rid).getNexts();
+            if(nexts.empty()) continue;
+            size_t j = gen() % nexts.size();
+            out.removed_edges.push_back(make_pair(rid, nexts[j]));
+            nexts.erase(nexts.begin() + j);
+        }
+        step(k, "edges out", out);
+        for(auto &e : out.removed_edges) {
+            rg.at(e.first).addNext(e.second);
+            in.added_edges.push_back(e);
+        }
+        step(k, "edges in", in);
+
+        // 'k' rules out and back in, with the edges to them, one is left
+        out = in = RuleGraphDelta();
+        set<int> removed;
+        while(removed.size() < min((size_t)k, rids.size() - 1)) {
+            removed.insert(rids[gen() % rids.size()]);
+        }
+        vector<pair<int, int>> edges;
+        for(auto &it : rg) {
+            if(removed.count(it.first)) continue;
+            vector<int> &nexts = it.second.getNexts();
+            for(auto v : nexts) {
+                if(removed.count(v)) edges.push_back(make_pair(it.first, v));
+            }
+            nexts.erase(remove_if(nexts.begin(), nexts.end(), [&](int v) { return removed.count(v) > 0; }), nexts.end());
+        }
+        map<int, RuleNode> saved;
+        for(auto rid : removed) {
+            saved.emplace(rid, rg.at(rid));
+            rg.erase(rid);
+            out.removed_rules.push_back(rid);
+        }
+        step(k, "rules out", out);
+        for(auto &it : saved) {
+            rg.emplace(it.first, it.second);
+            in.added_rules.push_back(it.first);
+        }
+        for(auto &e : edges) {
+            rg.at(e.first).addNext(e.second);
+        }
+        step(k, "rules in", in);
+    }
+}
+
+/* heap allocations per rule in each phase of setup on a topology, with path length threshold 'plt' */
+void allocs(string name, unsigned plt)
+{
+    long rules = 0;
+    long last = allocations;
+    auto phase = [&](const char *what) {
+        long now = allocations;
+        printf("[ ] %-10s %10ld allocs %8.2f per rule\n", what, now - last, double(now - last) / rules);
+        last = allocations;
+    };
+
+    SwitchGraph sg;
+    RuleGraph rg;
+    IO::instance().LoadTopo(name, sg, rg);
+    rules = rg.size();
+    printf("[ ] %s: %ld rules, %zu switches\n", name.c_str(), rules, sg.size());
+    phase("load");
+
+    PathSet ps;
+    PathCover(rg, ps, "hopcroft-karp", plt == (unsigned)INF ? 0 : plt);
+    phase("pathcover");
+
+    PathSet split_ps;
+    for(auto &p : ps) {
+        if(p.size() <= plt) {
+            // short enough to keep as a whole
+            split_ps.push_back(move(p));
+            continue;
+        }
+        for(auto iter = p.begin(); iter < p.end(); iter += plt) {
+            split_ps.push_back(vector<int>(iter, iter + plt >= p.end() ? p.end() : iter + plt));
+        }
+    }
+    phase("split");
+
+    Assignments a;
+    ReportHeaderAssignment(sg, rg, split_ps, "compact", a);
+    phase("assign");
+
+    SwitchTestHeaders sth;
+    SwitchHeadersCalculation(sg, a, sth);
+    PathPacketHeaders pph;
+    PathTestHeaders pth;
+    PathHeadersCalculation(sg, rg, a, split_ps, pph, pth);
+    phase("headers");
+}
+
+int main(int argc, char** argv)
+{
+    string mode;
+    int n = 0;
+    string name = "compact.example.topo";
+
+    int opt;
+    while((opt = getopt(argc, argv, "m:n:f:")) != -1) {
+        switch(opt) {
+            case 'm': mode = optarg; break;
+            case 'n': n = atoi(optarg); break;
+            case 'f': name = optarg; break;
+            default: usage(); return 0;
+        }
+    }
+
+    try {
+        if(mode == "hsa") {
+            hsa(n > 0 ? n : 4096);
+        }
+        else if(mode == "translate") {
+            translate(n > 0 ? n : 1000000);
+        }
+        else if(mode == "edges") {
+            edges(n > 0 ? n : 16384);
+        }
+        else if(mode == "twophase") {
+            twophase(n > 0 ? n : 125000);
+        }
+        else if(mode == "chains") {
+            chains(n > 0 ? n : 1000000);
+        }
+        else if(mode == "warmstart") {
+            warmstart(name, n > 0 ? n : INF);
+        }
+        else if(mode == "parallel") {
+            parallel(name, n > 0 ? n : INF);
+        }
+        else if(mode == "incremental") {
+            incremental(name, n > 0 ? n : INF);
+        }
+        else if(mode == "allocs") {
+            allocs(name, n > 0 ? n : INF);
+        }
+        else {
+            usage();
+            return 0;
+        }
+    }
+    catch(const char* err) {
+        printf("\033[31m[x] error: %s\033[0m\n", err);
+    }
+
+    return 0;
+}
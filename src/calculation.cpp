@@ -1,19 +1,21 @@
 #include "core.hpp"
 
-dynbitset GetPacketHeader(RuleGraph &rg, vector<int> path);
-dynbitset GetTestHeader(SwitchGraph &sg, Assignments &a, vector<int> targets);
+Header GetPacketHeader(const RuleGraph &rg, const vector<int> &path);
+TestHeader GetTestHeader(SwitchGraph &sg, Assignments &a, const vector<int> &targets, Arena *arena=nullptr);
 
 void SwitchHeadersCalculation(SwitchGraph &sg, Assignments &a, SwitchTestHeaders &sth)
 {
-    for(auto it : sg) {
+    Arena arena;
+    for(auto &it : sg) {
+        ArenaScope scope(arena);
         int s = it.first;
         vector<int> targets = {s};
-        sth[s] = GetTestHeader(sg, a, targets);
+        sth[s] = GetTestHeader(sg, a, targets, &arena);
     }
     
 #ifdef DEBUG
     printf("[ ] switch test headers calculated as below:\n");
-    for(auto it : a) {
+    for(auto &it : a) {
         int s = it.first;
         if(s != SID_OF_MASKLEN) {
             printf("    - %d - %s\n", s, HSA::stringify(sth[s]).c_str());
@@ -22,18 +24,20 @@ void SwitchHeadersCalculation(SwitchGraph &sg, Assignments &a, SwitchTestHeaders
 #endif
 }
 
-void PathHeadersCalculation(SwitchGraph &sg, RuleGraph &rg, Assignments &a, PathSet &ps, PathPacketHeaders &pph, PathTestHeaders &pth)
+void PathHeadersCalculation(SwitchGraph &sg, const RuleGraph &rg, Assignments &a, PathSet &ps, PathPacketHeaders &pph, PathTestHeaders &pth)
 {
-    for(auto p : ps) {
+    Arena arena;
+    for(auto &p : ps) {
+        ArenaScope scope(arena);
         pph[p] = GetPacketHeader(rg, p);
 
         vector<int> targets = GetTargets(rg, p);
-        pth[p] = GetTestHeader(sg, a, targets);
+        pth[p] = GetTestHeader(sg, a, targets, &arena);
     }
 
 #ifdef DEBUG
     printf("[ ] path packet headers and test headers calculated as below:\n");
-    for(auto p : ps) {
+    for(auto &p : ps) {
         printf("    - <");
         for(auto x : p) {
             printf(" %d(%d)", x, rg.at(x).getRule().getSID());
@@ -43,29 +47,46 @@ void PathHeadersCalculation(SwitchGraph &sg, RuleGraph &rg, Assignments &a, Path
 #endif
 }
 
-dynbitset GetPacketHeader(RuleGraph &rg, vector<int> path)
+Header GetPacketHeader(const RuleGraph &rg, const vector<int> &path)
 {
-    dynbitset ph;
+    Header ph;
 
     // TODO: handle set-field
     // observation: after a rule that sets a bit, the later reachability is independent
     // of the original bit value, and ensured when path cover is solved
     // solution: bit-by-bit initialization. h[i] = intersection(r1[i], ..., rk[i])
     // where rk is the first rule that sets ith bit.
+    bool prefixed = true;
     for(auto r : path) {
-        dynbitset rh = rg.at(r).getRule().getInHeader();
+        prefixed = prefixed && rg.at(r).getRule().isPrefix();
+    }
+
+    if(prefixed) {
+        Prefix pp = rg.at(path[0]).getRule().getInPrefix();
+        for(auto r : path) {
+            pp = HSA::intersection(pp, rg.at(r).getRule().getInPrefix());
+        }
+
+        // an empty result keeps its non-conflicting digits in the general form
+        if(!HSA::isEmpty(pp)) {
+            return HSA::expand(pp);
+        }
+    }
+
+    for(auto r : path) {
+        const Header &rh = rg.at(r).getRule().getInHeader();
         ph = (r == path[0]) ? rh : HSA::intersection(ph, rh);
     }
 
     return ph;
 }
 
-dynbitset GetTestHeader(SwitchGraph &sg, Assignments &a, vector<int> targets)
+TestHeader GetTestHeader(SwitchGraph &sg, Assignments &a, const vector<int> &targets, Arena *arena)
 {
     int masklen = a[SID_OF_MASKLEN].first;
-    dynbitset th(masklen * 2);
+    TestHeader th(masklen);
     
-    for(size_t ith = 0; ith < th.size() / 2; ith++) {
+    for(size_t ith = 0; ith < th.size(); ith++) {
         HSA::set(th, ith, 'x');
     }
     
@@ -90,7 +111,7 @@ dynbitset GetTestHeader(SwitchGraph &sg, Assignments &a, vector<int> targets)
     }
     
     // obey all reporters to activate them
-    set<int> reporters = GetReporters(sg, targets);
+    ReporterSet reporters = GetReporters(sg, targets, arena);
     for(auto s : reporters) {
         if(!HSA::set(th, a[s].first, a[s].second ? '1' : '0')) {
             throw "GetTestHeader() failed on reporters.";
@@ -113,9 +134,10 @@ dynbitset GetTestHeader(SwitchGraph &sg, Assignments &a, vector<int> targets)
     return th;
 }
 
-vector<int> GetTargets(RuleGraph &rg, vector<int> &path)
+vector<int> GetTargets(const RuleGraph &rg, const vector<int> &path)
 {
     vector<int> targets;
+    targets.reserve(path.size());
     for(auto r : path) {
         targets.push_back(rg.at(r).getRule().getSID());
     }
@@ -123,9 +145,9 @@ vector<int> GetTargets(RuleGraph &rg, vector<int> &path)
     return targets;
 }
 
-set<int> GetReporters(SwitchGraph &sg, vector<int> &targets)
+ReporterSet GetReporters(SwitchGraph &sg, const vector<int> &targets, Arena *arena)
 {
-    set<int> reporters;
+    ReporterSet reporters{ReporterSet::allocator_type(arena)};
     
     for(auto s : targets) {
         for(auto n : sg.at(s).getNeighbors()) {
@@ -1,68 +1,362 @@
 #include "core.hpp"
 
-static void bfs(RuleGraph &rg, int src, TransPath &transpath);
-void TransClosure(RuleGraph &rg, TransPath &transpath)
+/*
+ * Header-aware transitive closure, one bfs per source rule.
+ *
+ * A bfs from 'src' also walks the closure edges found by the bfs of every
+ * lower source, as if the sources ran one after another in index order.
+ * Those sources are all descendants of 'src', so the sources run in waves
+ * of equal height (longest path down to a sink): when a wave starts, every
+ * descendant is done, and the sources of the wave run in parallel. A bfs
+ * reads only the base edges of higher sources, so the closure is the same
+ * for any number of threads.
+ *
+ * With a depth, a bfs walks only the edges of 'g' and goes at most that
+ * many hops from 'src', so a closure edge spans at most 'depth' rules and
+ * all sources are independent. With a path length threshold, longer edges
+ * would be sliced apart after the path cover anyway.
+ *
+ * TransClosureOf() and TransPathsOf() walk the given sources only, on the
+ * edges of 'g' alone as with a depth, so a source does not depend on the
+ * others and the closure of some can be walked again after 'g' changed.
+ *
+ * Predecessors are not kept, that would take a hash entry per closure
+ * edge. TransPaths() runs the bfs again for the sources of matched edges
+ * only, over the finished closure, and keeps just the rules in between.
+ *
+ * On dense graphs, the header check is a second pass over plain graph
+ * edges. Testing a next that does not match the reachable header of 'u'
+ * has no effect, and many sources reach 'u' with the same header. So the
+ * nexts of 'u' matching a header are found once, by the word-parallel
+ * batch test, and kept as a bit mask. A bfs then walks the set bits of
+ * the mask, in the order it would have tested the nexts.
+ */
+
+// mean out degree from which nexts are tested by cached masks
+#define DENSE_DEGREE 8
+// words of masks a thread keeps before starting over (64 MB)
+#define MASK_CACHE_WORDS (1 << 23)
+
+// scratch of one thread, indexed by rule, reset lazily by stamping with 'src'
+struct BfsScratch {
+    vector<int> out_header; // set-field(reachable header)
+    vector<int> vis;
+    vector<int> linked;     // 'v' is in the nexts of 'src' already
+    vector<int> pred;       // 'src' -> ... -> pred[v] -> 'v', valid if vis[v] == src
+    vector<int> hops;       // from 'src' to a queued rule, with a depth only
+    vector<int> q;
+    Arena arena;            // what this thread found, adopted by the caller's arena
+
+    // (u, with closure edges, header) -> offset in 'words' of the mask of the
+    // nexts of 'u' that match the header
+    unordered_map<uint64_t, size_t> masks;
+    vector<uint64_t> words;
+    vector<Header> headers; // in headers of the nexts being tested
+};
+
+// nexts of 'u' seen by the bfs from 'src': the edges of 'g' and, if the bfs
+// of 'u' came before, the closure edges it found (empty once in 'g' already)
+struct BfsNexts {
+    DenseRuleGraph::Nexts base;
+    DenseRuleGraph::Nexts extra;
+};
+
+template<class NextsOf, class Reach>
+static void bfs(const DenseRuleGraph &g, int src, int depth, bool dense, NextsOf nexts_of, Reach reach, BfsScratch &s);
+static const uint64_t* MatchMask(const DenseRuleGraph &g, int u, bool extra, int hid, const BfsNexts &nexts, BfsScratch &s);
+
+template<class NextsOf>
+static void Close(const DenseRuleGraph &g, int src, int depth, bool dense, NextsOf nexts_of, BfsScratch &s, ArenaNexts &added);
+template<class Sources>
+static void Paths(const DenseRuleGraph &g, const vector<int> &rank, int depth, const DenseRuleGraph *closure, size_t count, Sources sources, const vector<int> &match, TransPath &transpath, Arena &arena);
+
+static void InitScratch(deque<BfsScratch> &scratch, int n, int depth, bool pred);
+
+void TransClosure(const DenseRuleGraph &g, const vector<int> &topoorder, int depth, DenseRuleGraph &closure, Arena &arena)
 {
-    for(auto it : rg) {
-        int r = it.first;
-        bfs(rg, r, transpath);
+    int n = g.size();
+
+    // height of each rule, from the sinks up in reverse topological order
+    // (all sources in one wave with a depth)
+    vector<int> height(n, 0);
+    int levels = (n > 0) ? 1 : 0;
+    for(auto it = topoorder.rbegin(); it != topoorder.rend() && !depth; it++) {
+        int u = *it;
+        for(auto v : g.getNexts(u)) {
+            height[u] = max(height[u], height[v] + 1);
+        }
+        levels = max(levels, height[u] + 1);
+    }
+
+    // rules bucketed by height, in index order within a wave
+    vector<int> wave_offs(levels + 1, 0);
+    for(int r = 0; r < n; r++) {
+        wave_offs[height[r] + 1]++;
+    }
+    for(int h = 0; h < levels; h++) {
+        wave_offs[h + 1] += wave_offs[h];
+    }
+    vector<int> waves(n);
+    vector<int> fill(wave_offs.begin(), wave_offs.end() - 1);
+    for(int r = 0; r < n; r++) {
+        waves[fill[height[r]]++] = r;
+    }
+
+    ThreadPool &pool = ThreadPool::instance();
+    deque<BfsScratch> scratch(pool.size());
+    InitScratch(scratch, n, depth, false);
+    bool dense = g.edges() >= (size_t)DENSE_DEGREE * n;
+
+    // closure edges of each source beyond those of 'g'
+    vector<ArenaNexts> extra(n);
+    for(int h = 0; h < levels; h++) {
+        pool.run(wave_offs[h + 1] - wave_offs[h], [&](size_t i) {
+            int src = waves[wave_offs[h] + i];
+            auto nexts_of = [&](int u) {
+                DenseRuleGraph::Nexts e{nullptr, nullptr};
+                if(!depth && u < src) {
+                    e = DenseRuleGraph::Nexts{extra[u].data(), extra[u].data() + extra[u].size()};
+                }
+                return BfsNexts{g.getNexts(u), e};
+            };
+            Close(g, src, depth, dense, nexts_of, scratch[ThreadPool::worker()], extra[src]);
+        });
+    }
+
+    // what the threads found lives as long as the arena of path cover
+    for(auto &s : scratch) {
+        arena.adopt(s.arena);
     }
 
+    closure = DenseRuleGraph(g, extra);
+
 #ifdef VERBOSE
+    printf("[ ] transitive closure in %d waves of %.1f rules on average\n", levels, levels ? double(n) / levels : 0.0);
     printf("[ ] transitive closure of rule graph as below:\n");
-    for(auto it : rg) {
-        int r1 = it.first;
-        printf("    - %d -", r1);
-        for(auto r2 : rg[r1].getNexts()) {
-            printf(" %d", r2);
+    for(int r1 = 0; r1 < closure.size(); r1++) {
+        printf("    - %d -", closure.getRID(r1));
+        for(auto r2 : closure.getNexts(r1)) {
+            printf(" %d", closure.getRID(r2));
         }
         printf("\n");
     }
 #endif
 }
 
-void bfs(RuleGraph &rg, int src, TransPath &transpath)
+void TransClosureOf(const DenseRuleGraph &g, const vector<int> &sources, int depth, vector<ArenaNexts> &extra, Arena &arena)
+{
+    ThreadPool &pool = ThreadPool::instance();
+    deque<BfsScratch> scratch(pool.size());
+    InitScratch(scratch, g.size(), depth, false);
+    bool dense = g.edges() >= (size_t)DENSE_DEGREE * g.size();
+
+    pool.run(sources.size(), [&](size_t i) {
+        auto nexts_of = [&](int u) {
+            return BfsNexts{g.getNexts(u), DenseRuleGraph::Nexts{nullptr, nullptr}};
+        };
+        Close(g, sources[i], depth, dense, nexts_of, scratch[ThreadPool::worker()], extra[i]);
+    });
+
+    for(auto &s : scratch) {
+        arena.adopt(s.arena);
+    }
+}
+
+void TransPaths(const DenseRuleGraph &g, const vector<int> &topoorder, int depth, const DenseRuleGraph &closure, const vector<int> &match, TransPath &transpath, Arena &arena)
+{
+    int n = g.size();
+    vector<int> rank(n);
+    for(int i = 0; i < n; i++) {
+        rank[topoorder[i]] = i;
+    }
+    transpath.assign(n, ArenaNexts());
+    Paths(g, rank, depth, &closure, n, [](size_t i) { return (int)i; }, match, transpath, arena);
+}
+
+void TransPathsOf(const DenseRuleGraph &g, const vector<int> &rank, int depth, const vector<int> &sources, const vector<int> &match, TransPath &transpath, Arena &arena)
+{
+    Paths(g, rank, depth, nullptr, sources.size(), [&](size_t i) { return sources[i]; }, match, transpath, arena);
+}
+
+template<class NextsOf>
+void Close(const DenseRuleGraph &g, int src, int depth, bool dense, NextsOf nexts_of, BfsScratch &s, ArenaNexts &added)
+{
+    added = ArenaNexts(&s.arena);
+    auto reach = [&](int u, int v) {
+        // build edge if 'v' is reachable from 'src'
+        // 'v' can be in the nexts of 'src' already in two cases:
+        // 1. 'v' and 'src' are on the neighboring switches
+        // 2. 'v' is reachable from both u1 and u2
+        if(s.linked[v] != src) {
+            s.linked[v] = src;
+            added.push_back(v);
+        }
+        return true;
+    };
+    bfs(g, src, depth, dense, nexts_of, reach, s);
+}
+
+// the path behind the matched edge out of sources(i) goes to transpath[i]
+template<class Sources>
+void Paths(const DenseRuleGraph &g, const vector<int> &rank, int depth, const DenseRuleGraph *closure, size_t count, Sources sources, const vector<int> &match, TransPath &transpath, Arena &arena)
 {
-    queue<int> q;
-    q.push(src);
-
-    HeaderMap in_header;    // reachable header
-    HeaderMap out_header;   // set-field(reachable header)
-    in_header[src] = rg.at(src).getRule().getInHeader();
-    out_header[src] = rg.at(src).getRule().getOutHeader();
-    
-    set<int> vis;
-    while(!q.empty()) {
-        int u = q.front();
-        q.pop();
-        vis.insert(u);
-
-        for(auto v : rg.at(u).getNexts()) {
-            in_header[v] = rg.at(v).getRule().getInHeader();
-            // out_header[v] won't be used if 'v' is unreachable
-
-            if(HSA::matchable(out_header[u], in_header[v])) {
-                // TODO: if v is reachable from both u1 and u2, how to determine whether
-                // src->u1->v or src->u2->v? the path with larger header space? the more
-                // critical rule of u1 and u2 that deserves more tests? 
-                
-                // build edge if 'v' is reachable from 'src'
-                // 'v' can be in the 'nexts' of 'src' already in two cases:
-                // 1. 'v' and 'src' are on the neighboring switches
-                // 2. 'v' is reachable from both u1 and u2
-                rg.at(src).addNextIfNotExists(v);      
-                transpath[src][v] = u;  // 'src' -> ... -> 'u' -> 'v'
-                
-                // in_header[v] and out_header[v] shouldn't be updated if 'v' is unreachable
-                in_header[v] = HSA::intersection(out_header[u], in_header[v]);
-                out_header[v] = rg.at(v).getRule().getAvailableOutHeader(in_header[v]);
-
-                // enqueue reachable 'v'
-                if(vis.find(v) == vis.end()) {
-                    q.push(v);
-                    vis.insert(v);
+    int n = g.size();
+    ThreadPool &pool = ThreadPool::instance();
+    deque<BfsScratch> scratch(pool.size());
+    InitScratch(scratch, n, depth, true);
+    bool dense = g.edges() >= (size_t)DENSE_DEGREE * n;
+
+    pool.run(count, [&](size_t i) {
+        int src = sources(i);
+        int dst = match[src];
+        if(dst == -1) return;
+
+        BfsScratch &s = scratch[ThreadPool::worker()];
+        // the same walk as in TransClosure(), with the closure edges of lower sources in 'closure'
+        // (none without it, as in TransClosureOf())
+        auto nexts_of = [&](int u) {
+            DenseRuleGraph::Nexts base = g.getNexts(u);
+            DenseRuleGraph::Nexts e{base.end(), base.end()};
+            if(closure && !depth && u < src) {
+                // the edges of 'g' come first in 'closure', then the rest
+                DenseRuleGraph::Nexts all = closure->getNexts(u);
+                e = DenseRuleGraph::Nexts{all.begin() + base.size(), all.end()};
+            }
+            return BfsNexts{base, e};
+        };
+        auto reach = [&](int u, int v) {
+            // a rule after 'dst' in topological order can't lead to it, and
+            // leaving it out does not change the order the others are reached in
+            s.pred[v] = u;
+            return rank[v] < rank[dst];
+        };
+        bfs(g, src, depth, dense, nexts_of, reach, s);
+
+        // trace back from 'dst' and reverse, the last predecessor found wins as it did in a map
+        ArenaNexts &sub = transpath[i];
+        sub = ArenaNexts(&s.arena);
+        for(int v = dst; v != src; v = s.pred[v]) {
+            sub.push_back(v);
+        }
+        reverse(sub.begin(), sub.end());
+    });
+
+    for(auto &s : scratch) {
+        arena.adopt(s.arena);
+    }
+}
+
+void InitScratch(deque<BfsScratch> &scratch, int n, int depth, bool pred)
+{
+    for(auto &s : scratch) {
+        s.out_header.assign(n, -1);
+        s.vis.assign(n, -1);
+        if(depth) {
+            s.hops.assign(n, 0);
+        }
+        if(pred) {
+            s.pred.assign(n, -1);
+        }
+        else {
+            s.linked.assign(n, -1);
+        }
+    }
+}
+
+template<class NextsOf, class Reach>
+void bfs(const DenseRuleGraph &g, int src, int depth, bool dense, NextsOf nexts_of, Reach reach, BfsScratch &s)
+{
+    HeaderPool &pool = HeaderPool::instance();
+
+    s.out_header[src] = g.getOutHeaderId(src);
+    if(!s.linked.empty()) {
+        for(auto v : g.getNexts(src)) {
+            s.linked[v] = src;
+        }
+    }
+
+    s.q.clear();
+    s.q.push_back(src);
+    if(depth) {
+        s.hops[src] = 0;
+    }
+    for(size_t head = 0; head < s.q.size(); head++) {
+        int u = s.q[head];
+        s.vis[u] = src;
+        // rules are dequeued by hops, the rest are all 'depth' hops away
+        if(depth && s.hops[u] == depth) break;
+
+        BfsNexts nexts = nexts_of(u);
+        size_t nb = nexts.base.size();
+        size_t ne = nexts.extra.size();
+
+        // 'v' matches the reachable header of 'u'
+        // TODO: if v is reachable from both u1 and u2, how to determine whether
+        // src->u1->v or src->u2->v? the path with larger header space? the more
+        // critical rule of u1 and u2 that deserves more tests?
+        auto visit = [&](int v) {
+            // 'src' -> ... -> 'u' -> 'v', false if nothing after 'v' matters
+            bool walk = reach(u, v);
+
+            // reachable header of 'v' through 'u'
+            int in_header = pool.intersection(s.out_header[u], g.getInHeaderId(v));
+            s.out_header[v] = g.getAvailableOutHeaderId(v, in_header);
+
+            // enqueue reachable 'v'
+            if(walk && s.vis[v] != src) {
+                s.q.push_back(v);
+                s.vis[v] = src;
+                if(depth) {
+                    s.hops[v] = s.hops[u] + 1;
+                }
+            }
+        };
+
+        if(dense) {
+            const uint64_t *mask = MatchMask(g, u, ne > 0, s.out_header[u], nexts, s);
+            for(size_t w = 0; w < (nb + ne + 63) / 64; w++) {
+                for(uint64_t m = mask[w]; m; m &= m - 1) {
+                    size_t i = 64 * w + __builtin_ctzll(m);
+                    visit((i < nb) ? nexts.base.begin()[i] : nexts.extra.begin()[i - nb]);
+                }
+            }
+        }
+        else {
+            for(size_t i = 0; i < nb + ne; i++) {
+                int v = (i < nb) ? nexts.base.begin()[i] : nexts.extra.begin()[i - nb];
+                if(pool.matchable(s.out_header[u], g.getInHeaderId(v))) {
+                    visit(v);
                 }
             }
         }
     }
 }
+
+const uint64_t* MatchMask(const DenseRuleGraph &g, int u, bool extra, int hid, const BfsNexts &nexts, BfsScratch &s)
+{
+    uint64_t key = (uint64_t)u << 33 | (uint64_t)extra << 32 | (uint32_t)hid;
+    auto found = s.masks.find(key);
+    if(found != s.masks.end()) {
+        return s.words.data() + found->second;
+    }
+
+    if(s.words.size() > MASK_CACHE_WORDS) {
+        s.masks.clear();
+        s.words.clear();
+    }
+
+    size_t nb = nexts.base.size();
+    size_t n = nb + nexts.extra.size();
+    HeaderPool &pool = HeaderPool::instance();
+    s.headers.resize(n);
+    for(size_t i = 0; i < n; i++) {
+        int v = (i < nb) ? nexts.base.begin()[i] : nexts.extra.begin()[i - nb];
+        s.headers[i] = pool.get(g.getInHeaderId(v));
+    }
+
+    size_t off = s.words.size();
+    s.words.resize(off + (n + 63) / 64);
+    HSA::matchable(pool.get(hid), s.headers.data(), n, s.words.data() + off);
+    s.masks[key] = off;
+    return s.words.data() + off;
+}
@@ -11,7 +11,7 @@ void BruteForceCompactColoring(SwitchGraphAlpha &alpha, SwitchGraphBeta &beta, C
 {
     // all vertices are uncolored at first
     unordered_map<int, Color> color; 
-    for(auto it : alpha) {
+    for(auto &it : alpha) {
         int s = it.first;
         color[s] = make_pair(-1, 0);
     }
@@ -31,7 +31,7 @@ void BruteForceCompactColoring(SwitchGraphAlpha &alpha, SwitchGraphBeta &beta, C
     
     dfs(alpha, beta, color, 0, 0);
     
-    for(auto it : opt) {
+    for(auto &it : opt) {
         int v = it.first;
         coloring[opt[v]].push_back(v);
     }
@@ -52,7 +52,7 @@ void dfs(SwitchGraphAlpha &alpha, SwitchGraphBeta &beta, unordered_map<int, Colo
 {
 #ifdef DEBUG
     printf("ith=%d, c=%d color={", ith, c);
-    for(auto it : color) {
+    for(auto &it : color) {
         printf(" %d(%d,%d)", it.first, it.second.first, it.second.second);
     }
     printf(" }\n");
@@ -125,7 +125,7 @@ void GreedyCompactColoring(SwitchGraphAlpha &alpha, SwitchGraphBeta &beta, Compa
 {
     // all vertices are uncolored at first
     unordered_map<int, Color> color; 
-    for(auto it : alpha) {
+    for(auto &it : alpha) {
         int s = it.first;
         color[s] = make_pair(-1, 0);
     }
@@ -222,7 +222,7 @@ void GreedyColoring(SwitchGraphAlpha &alpha, Coloring &coloring)
 {
     // all vertices are uncolored at first
     unordered_map<int, int> color;
-    for(auto it : alpha) {
+    for(auto &it : alpha) {
         int s = it.first;
         color[s] = -1;
     }
@@ -258,7 +258,7 @@ void GreedyColoring(SwitchGraphAlpha &alpha, Coloring &coloring)
 
 void CountDegrees(SwitchGraphAlpha &alpha, set<pair<int, int>> &degrees)
 {
-    for(auto it : alpha) {
+    for(auto &it : alpha) {
         int s = it.first;
         int degree = alpha.at(s).size();
         degrees.insert(make_pair(degree, s));
@@ -4,21 +4,101 @@
 #include "structs.hpp"
 #include "io.hpp"
 #include "hsa.hpp"
+#include "pool.hpp"
+#include "threads.hpp"
+#include "matching.hpp"
 
 /* path cover */
-void TopoSort(RuleGraph &rg, vector<int> &topoorder);
-void TransClosure(RuleGraph &rg, TransPath &transpath);
-void Hungarian(RuleGraph &rg, unordered_map<int, int> &match);
-void HopcroftKarp(RuleGraph &rg, unordered_map<int, int> &match);
+void TopoSort(const DenseRuleGraph &g, vector<int> &topoorder);
+void TransClosure(const DenseRuleGraph &g, const vector<int> &topoorder, int depth, DenseRuleGraph &closure, Arena &arena);
+void TransPaths(const DenseRuleGraph &g, const vector<int> &topoorder, int depth, const DenseRuleGraph &closure, const vector<int> &match, TransPath &transpath, Arena &arena);
+// the same for 'sources' only, into extra[i] and transpath[i] for sources[i], walking the edges of 'g'
+// alone; 'rank' is the position of each rule in some topological order
+void TransClosureOf(const DenseRuleGraph &g, const vector<int> &sources, int depth, vector<ArenaNexts> &extra, Arena &arena);
+void TransPathsOf(const DenseRuleGraph &g, const vector<int> &rank, int depth, const vector<int> &sources, const vector<int> &match, TransPath &transpath, Arena &arena);
 
-void PathCover(RuleGraph &rg, PathSet &ps, bool fast);
+// 'matching' is hopcroft-karp, parallel (hopcroft-karp on the thread pool) or hungarian,
+// 'depth' bounds the hops a closure edge spans, 0 for none, and with 'warm'
+// hopcroft-karp starts from a Karp-Sipser matching
+void PathCover(const RuleGraph &rg, PathSet &ps, string matching, int depth, bool warm = false);
+
+/*
+ * Path cover kept up to date as rules and edges come and go.
+ *
+ * A closure bfs walks the edges of the rule graph alone, as with a depth in
+ * PathCover(), so the closure edges of a rule only change if it reaches a
+ * changed rule within 'depth' - 1 hops (at all without a depth). Only those
+ * rules are walked again, the matching is repaired around them, and the
+ * rules behind a matched closure edge are traced again for changed pairs
+ * only.
+ *
+ * A rule keeps its index for as long as it is in the graph, so the frozen
+ * graph, its reversed edges, the closure, the matching and the traced rules
+ * are kept from one update to the next, and only the rows of changed rules
+ * are replaced. The topological order is kept by moving the rules between
+ * the ends of each new edge that goes against it (Pearce and Kelly), which
+ * also finds a cycle. Only the paths through a changed pair, traced rule,
+ * removed or new rule are taken out of the path set and put back.
+ *
+ * An update reads the whole rule graph once to find the rows that changed,
+ * and clears scratch of a word per rule for the closure bfs; the rest takes
+ * time in the rules and edges around the change. Replaced rows and removed
+ * rules are left behind, until they make up half the graph and the cover is
+ * built again.
+ */
+class IncrementalPathCover {
+public:
+    // 'depth' as in PathCover()
+    explicit IncrementalPathCover(int depth);
+
+    // path cover of 'rg' from scratch into 'ps', the same as PathCover() with a depth
+    void build(const RuleGraph &rg, PathSet &ps);
+    // 'ps' from the last call changed into the path cover of 'rg', which is the
+    // graph of the last call changed by 'delta'; a delta that does not match
+    // both throws, the edges to and from added or removed rules go with the
+    // rules and are not listed, and a cycle throws and leaves build() to call
+    void update(const RuleGraph &rg, const RuleGraphDelta &delta, PathSet &ps);
+
+    // rules whose closure the last call walked, and what its matching repair did
+    int walked() const;
+    int dropped() const;
+    int augmented() const;
+
+private:
+    int stamp();
+    void unlink(int u, int w);
+    void reorder(int x, int y);
+
+    int depth;
+    bool built = false;
+    DenseRuleGraph g;
+    vector<vector<int>> prevs;          // rules with each rule in their nexts
+    vector<int> rank;                   // of each rule in a topological order of 'g'
+    int nranks = 0;                     // ranks handed out so far
+    DenseRuleGraph closure;
+    RepairMatcher matcher;
+    vector<int> match;
+    vector<int> from;                   // the rule matched to each rule, or -1
+    vector<vector<int>> subpaths;       // rule ids after each matched rule up to its match
+    vector<int> head;                   // first rule of the path of each rule
+    vector<int> at;                     // position in the path set of the path from each first rule
+    vector<int> heads;                  // first rule of each path in the path set
+    vector<int> unused;                 // indices of removed rules
+    vector<int> seen;                   // stamped with 'epoch'
+    int epoch = 0;
+    vector<int> hops;
+    vector<int> last;                   // match of a rule before the repair if it changed, or -2
+    int nwalked = 0;
+    int ndropped = 0;
+    int naugmented = 0;
+};
 
 /* report header assignment */
 void BruteForceCompactColoring(SwitchGraphAlpha &alpha, SwitchGraphBeta &beta, CompactColoring &coloring);
 void GreedyCompactColoring(SwitchGraphAlpha &alpha, SwitchGraphBeta &beta, CompactColoring &coloring);
 
 void GreedyColoring(SwitchGraphAlpha &alpha, Coloring &coloring);
-void Edmonds(SwitchGraphMatrix &beta, int n, vector<int> &vertices, unordered_map<int, int> &match);
+void Edmonds(SwitchGraphMatrix &beta, vector<int> &vertices, vector<int> &mate);
 
 void SimpleAssignment(SwitchGraph &sg, Assignments &a);
 void GreedyColoringAssignment(SwitchGraph &sg, TargetsSet &tss, Assignments &a);
@@ -26,13 +106,13 @@ void CompactColoringAssignment(SwitchGraph &sg, TargetsSet &tss, bool opt, Assig
 void TwoPhaseAssignment(SwitchGraph &sg, TargetsSet &tss, Assignments &a);
 
 void QuickAssignment(SwitchGraph &sg, TargetsSet &tss, string mode, Assignments &a);
-void ReportHeaderAssignment(SwitchGraph &sg, RuleGraph &rg, PathSet &ps, string mode, Assignments &a);
+void ReportHeaderAssignment(SwitchGraph &sg, const RuleGraph &rg, PathSet &ps, string mode, Assignments &a);
 
 /* header calculation */
-vector<int> GetTargets(RuleGraph &rg, vector<int> &path);
-set<int> GetReporters(SwitchGraph &sg, vector<int> &targets);
+vector<int> GetTargets(const RuleGraph &rg, const vector<int> &path);
+ReporterSet GetReporters(SwitchGraph &sg, const vector<int> &targets, Arena *arena=nullptr);
 
 void SwitchHeadersCalculation(SwitchGraph &sg, Assignments &a, SwitchTestHeaders &sth);
-void PathHeadersCalculation(SwitchGraph &sg, RuleGraph &rg, Assignments &a, PathSet &ps, PathPacketHeaders &pph, PathTestHeaders &pth);
+void PathHeadersCalculation(SwitchGraph &sg, const RuleGraph &rg, Assignments &a, PathSet &ps, PathPacketHeaders &pph, PathTestHeaders &pth);
 
 #endif
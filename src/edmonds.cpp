@@ -6,30 +6,32 @@
 // <OutEdgeList, VertextList, Directed>
 typedef boost::adjacency_list<boost::vecS, boost::vecS, boost::undirectedS> BoostGraph;
 
-void Edmonds(SwitchGraphMatrix &beta, int n, vector<int> &vertices, unordered_map<int, int> &match)
+// 'vertices' lists 0..n-1 in the order their edges are added to the boost graph,
+// 'mate[u]' is the vertex matched to 'u' or -1
+void Edmonds(SwitchGraphMatrix &beta, vector<int> &vertices, vector<int> &mate)
 {
+    int n = beta.size();
+
     // boost graph representation
     BoostGraph bg(n);
     for(auto u : vertices) {
+        const uint64_t *row = beta.row(u);
         for(auto v : vertices) {
-            if(beta[u][v]) {
+            if(row[v / 64] >> (v % 64) & 1) {
                 boost::add_edge(u, v, bg);
             }
         }
     }
     
     // maximum matching
-    vector<boost::graph_traits<BoostGraph>::vertex_descriptor> mate(n);
-    boost::edmonds_maximum_cardinality_matching(bg, &mate[0]);
+    vector<boost::graph_traits<BoostGraph>::vertex_descriptor> bmate(n);
+    boost::edmonds_maximum_cardinality_matching(bg, &bmate[0]);
     
     // fetch matching 
-    boost::graph_traits<BoostGraph>::vertex_iterator vi, vi_end;
-    for(boost::tie(vi, vi_end) = boost::vertices(bg); vi != vi_end; vi++) {
-        if(mate[*vi] != boost::graph_traits<BoostGraph>::null_vertex()) {
-            // record only once
-            if(*vi < mate[*vi]) {
-                match[*vi] = mate[*vi];
-            }
+    mate.assign(n, -1);
+    for(int u = 0; u < n; u++) {
+        if(bmate[u] != boost::graph_traits<BoostGraph>::null_vertex()) {
+            mate[u] = bmate[u];
         }
     }
 }
@@ -1,31 +1,31 @@
 #include "core.hpp"
 
-static int dist;
-static unordered_map<int, int> d;                  // distance
+#include <random>
 
-static set<int> vis;
-static unordered_map<int, int> cx, cy;             // match
+HopcroftKarpMatcher::HopcroftKarpMatcher(bool warm) :
+    warm(warm)
+{
 
-static HeaderMap in_header;    // reachable header
-static HeaderMap out_header;   // set-field (reachable header)
+}
 
-static bool bfs(RuleGraph &rg);
-static bool dfs(RuleGraph &rg, int src);
-void HopcroftKarp(RuleGraph &rg, unordered_map<int, int> &match)
+void HopcroftKarpMatcher::run(const DenseRuleGraph &g, vector<int> &match)
 {
-    for(auto it : rg) {
-        int src = it.first;
-        cx[src] = cy[src] = -1;     // vertex split
-        in_header[src] = rg.at(src).getRule().getInHeader();
-        out_header[src] = rg.at(src).getRule().getOutHeader();
+    int n = g.size();
+    reset(g);
+    d.assign(n, 0);
+    nphases = 0;
+    nwarmed = 0;
+    if(warm) {
+        warmstart(g);
     }
     
-    while(bfs(rg)) {
-        for(auto it : rg) {
-            int src = it.first;
+    while(bfs(g)) {
+        nphases++;
+        // paths of a phase are disjoint, a rule that led nowhere stays out of it
+        stamp();
+        for(int src = 0; src < n; src++) {
             if(cx[src] == -1) {
-                vis.clear();
-                dfs(rg, src);
+                dfs(g, src);
             }
         }
     }
@@ -34,20 +34,29 @@ void HopcroftKarp(RuleGraph &rg, unordered_map<int, int> &match)
 
 #ifdef VERBOSE
     printf("[ ] maximum matching as below:\n");
-    for(auto it : match) {
-        printf("    - %d - %d\n", it.first, it.second);
+    for(int v = 0; v < n; v++) {
+        printf("    - %d - %d\n", g.getRID(v), match[v] == -1 ? -1 : g.getRID(match[v]));
     }
 #endif
 }
 
-bool bfs(RuleGraph &rg)
+int HopcroftKarpMatcher::phases() const
+{
+    return nphases;
+}
+
+int HopcroftKarpMatcher::warmed() const
 {
-   queue<int>  q;
-   for(auto it : rg) {
-       int u = it.first;
+    return nwarmed;
+}
+
+bool HopcroftKarpMatcher::bfs(const DenseRuleGraph &g)
+{
+   q.clear();
+   for(int u = 0; u < g.size(); u++) {
        if(cx[u] == -1) {
            d[u] = 0;
-           q.push(u);
+           q.push_back(u);
        }
        else {
            d[u] = INF; 
@@ -56,21 +65,20 @@ bool bfs(RuleGraph &rg)
 
    dist = INF;
     
-   while(!q.empty()) {
-       int u = q.front();
-       q.pop();
+   for(size_t head = 0; head < q.size(); head++) {
+       int u = q[head];
         
        // 'd[v]' must be 'dist' + 1 if 'd[u]' == 'dist'
        if(d[u] >= dist) break;
 
-       for(auto v : rg.at(u).getNexts()) {
-           if(HSA::matchable(out_header[u], in_header[v])) {
+       for(const int &v : g.getNexts(u)) {
+           if(feasible(g, u, &v)) {
                if(cy[v] == -1 && dist == INF) {
                    dist = d[u] + 1;
                }
                else if(cy[v] != -1 && d[cy[v]] == INF){
                    d[cy[v]] = d[u] + 1;
-                   q.push(cy[v]);
+                   q.push_back(cy[v]);
                }
            }
        }
@@ -79,33 +87,466 @@ bool bfs(RuleGraph &rg)
    return dist != INF;
 }
 
-bool dfs(RuleGraph &rg, int src)
+bool HopcroftKarpMatcher::dfs(const DenseRuleGraph &g, int src)
 {
-    for(auto v : rg.at(src).getNexts()) {
-        if(vis.find(v) != vis.end()) continue;
-        
-        if(HSA::matchable(out_header[src], in_header[v])) {
-            vis.insert(v);
-            
-            // search only the 'dist'th layer
-            if(cy[v] == -1 && dist != d[src] + 1) continue;
-            if(cy[v] != -1 && d[cy[v]] != d[src] + 1) continue;
-
-            // prune 'v' if it is matched at depth 'dist'
-            if(cy[v] != -1 && d[cy[v]] == dist) continue;
-            
-            if(cy[v] == -1 || dfs(rg, cy[v])) {
-                in_header[v] = HSA::intersection(out_header[src], rg.at(v).getRule().getInHeader());
-                out_header[v] = rg.at(v).getRule().getAvailableOutHeader(in_header[v]);
-                
-                // (re)match 'v' to 'src'
-                cx[src] = v;
-                cy[v] = src;
+    return augment(g, src, [&](int u, int v) { return layered(u, v); });
+}
+
+bool HopcroftKarpMatcher::layered(int u, int v) const
+{
+    // search only the 'dist'th layer
+    if(cy[v] == -1 && dist != d[u] + 1) return false;
+    if(cy[v] != -1 && d[cy[v]] != d[u] + 1) return false;
+
+    // prune 'v' if it is matched at depth 'dist'
+    if(cy[v] != -1 && d[cy[v]] == dist) return false;
+
+    return true;
+}
+
+/*
+ * Karp-Sipser: a rule with one unmatched neighbor left is matched to it,
+ * which a maximum matching can always do, and when there is none a random
+ * unmatched rule takes its first neighbor that is still free.
+ *
+ * Degrees count the edges whose headers match as the rules come, so the
+ * headers are tested once per edge. An edge is checked again with the
+ * headers left by the matches so far when it is taken. The order is
+ * random with a fixed seed, so a run is repeatable.
+ */
+void HopcroftKarpMatcher::warmstart(const DenseRuleGraph &g)
+{
+    HeaderPool &pool = HeaderPool::instance();
+    int n = g.size();
+
+    // edges whose headers match, out of each 'x' rule and into each 'y' rule
+    deg.assign(2 * n, 0);
+    out_offs.assign(n + 1, 0);
+    out_adj.clear();
+    for(int u = 0; u < n; u++) {
+        for(const int &v : g.getNexts(u)) {
+            // the headers are still those of the rules
+            if(feasible(g, u, &v)) {
+                out_adj.push_back(v);
+                deg[n + v]++;
+            }
+        }
+        out_offs[u + 1] = out_adj.size();
+        deg[u] = out_offs[u + 1] - out_offs[u];
+    }
+    in_offs.assign(n + 1, 0);
+    for(int v = 0; v < n; v++) {
+        in_offs[v + 1] = in_offs[v] + deg[n + v];
+    }
+    in_adj.resize(in_offs[n]);
+    order.assign(in_offs.begin(), in_offs.end() - 1);
+    for(int u = 0; u < n; u++) {
+        for(int i = out_offs[u]; i < out_offs[u + 1]; i++) {
+            in_adj[order[out_adj[i]]++] = u;
+        }
+    }
+
+    // rules with one neighbor left, 'u' for 'ux' and n + 'v' for 'vy'
+    q.clear();
+    for(int r = 0; r < 2 * n; r++) {
+        if(deg[r] == 1) q.push_back(r);
+    }
+
+    auto take = [&](int u, int v) {
+        if(!pool.matchable(out_header[u], in_header[v])) return false;
+        rematch(g, u, v);
+        nwarmed++;
+        for(int i = out_offs[u]; i < out_offs[u + 1]; i++) {
+            int y = out_adj[i];
+            if(cy[y] == -1 && --deg[n + y] == 1) q.push_back(n + y);
+        }
+        for(int i = in_offs[v]; i < in_offs[v + 1]; i++) {
+            int x = in_adj[i];
+            if(cx[x] == -1 && --deg[x] == 1) q.push_back(x);
+        }
+        return true;
+    };
+
+    // degree one reductions, then a random rule, until none is left
+    auto reduce = [&]() {
+        for(size_t head = 0; head < q.size(); head++) {
+            int r = q[head];
+            if(r < n && cx[r] == -1) {
+                for(int i = out_offs[r]; i < out_offs[r + 1]; i++) {
+                    if(cy[out_adj[i]] == -1) {
+                        take(r, out_adj[i]);
+                        break;
+                    }
+                }
+            }
+            else if(r >= n && cy[r - n] == -1) {
+                int v = r - n;
+                for(int i = in_offs[v]; i < in_offs[v + 1]; i++) {
+                    if(cx[in_adj[i]] == -1) {
+                        take(in_adj[i], v);
+                        break;
+                    }
+                }
+            }
+        }
+        q.clear();
+    };
+
+    reduce();
+    order.resize(n);
+    for(int u = 0; u < n; u++) {
+        order[u] = u;
+    }
+    shuffle(order.begin(), order.end(), mt19937(49));
+    for(auto u : order) {
+        if(cx[u] != -1) continue;
+        for(int i = out_offs[u]; i < out_offs[u + 1]; i++) {
+            if(cy[out_adj[i]] == -1 && take(u, out_adj[i])) break;
+        }
+        reduce();
+    }
+
+#ifdef VERBOSE
+    printf("[ ] karp-sipser warm start matched %d of %d rules\n", nwarmed, n);
+#endif
+}
+
+ParallelHopcroftKarpMatcher::ParallelHopcroftKarpMatcher(bool warm) :
+    HopcroftKarpMatcher(warm)
+{
+
+}
+
+void ParallelHopcroftKarpMatcher::run(const DenseRuleGraph &g, vector<int> &match)
+{
+    // claims only cost on a single thread, which finds the paths of a phase
+    // alone, as in a pool of one or inside a job of the pool (e.g. the
+    // batched components of PathCover()), where runs go inline
+    ThreadPool &pool = ThreadPool::instance();
+    if(pool.size() == 1 || pool.busy()) {
+        HopcroftKarpMatcher::run(g, match);
+        return;
+    }
+
+    int n = g.size();
+    reset(g);
+    d.assign(n, 0);
+    nphases = 0;
+    nwarmed = 0;
+    if(warm) {
+        warmstart(g);
+    }
+
+    // phases go on from the last run, so 'claims' is only cleared when it grows
+    if((int)claims.size() < n) {
+        vector<std::atomic<int>>(n).swap(claims);
+        phase = 0;
+    }
+    while((int)locals.size() < pool.size()) {
+        locals.emplace_back();
+    }
+
+    while(bfs(g)) {
+        nphases++;
+        if(phase == INF) {
+            for(auto &c : claims) c = 0;
+            phase = 0;
+        }
+        phase++;
+
+        roots.clear();
+        for(int src = 0; src < n; src++) {
+            if(cx[src] == -1) roots.push_back(src);
+        }
+
+        // roots in chunks, a search is too short to be handed out alone
+        const size_t chunk = 64;
+        std::atomic<int> found(0);
+        pool.run((roots.size() + chunk - 1) / chunk, [&](size_t c) {
+            Local &local = locals[ThreadPool::worker()];
+            int k = 0;
+            for(size_t i = c * chunk; i < min(roots.size(), (c + 1) * chunk); i++) {
+                k += search(g, roots[i], local);
+            }
+            found += k;
+        });
+        settle(g);
+
+        if(found == 0) {
+            stamp();
+            for(auto src : roots) {
+                dfs(g, src);
+            }
+        }
+    }
 
+    match = cx;
+
+#ifdef VERBOSE
+    printf("[ ] maximum matching in %d parallel phases as below:\n", nphases);
+    for(int v = 0; v < n; v++) {
+        printf("    - %d - %d\n", g.getRID(v), match[v] == -1 ? -1 : g.getRID(match[v]));
+    }
+#endif
+}
+
+bool ParallelHopcroftKarpMatcher::claim(int v)
+{
+    int c = claims[v].load(memory_order_acquire);
+    return c != phase && claims[v].compare_exchange_strong(c, phase, memory_order_acq_rel);
+}
+
+void ParallelHopcroftKarpMatcher::release(int v)
+{
+    claims[v].store(phase - 1, memory_order_release);
+}
+
+// Matcher::augment() over claimed 'y' rules: the match and in header of a
+// 'y' rule are only read once it is held
+bool ParallelHopcroftKarpMatcher::search(const DenseRuleGraph &g, int root, Local &local)
+{
+    vector<Frame> &frames = local.frames;
+    DenseRuleGraph::Nexts nexts = g.getNexts(root);
+    Frame f{root, nexts.begin(), nexts.end()};
+    frames.clear();
+    while(true) {
+        int down = -1;
+        for(; f.next != f.end; f.next++) {
+            int v = *f.next;
+            if(!claim(v)) continue;
+            if(!feasible(g, f.u, f.next) || !layered(f.u, v)) {
+                release(v);
+                continue;
+            }
+
+            if(cy[v] == -1) {
+                link(g, f.u, v, local);
+                for(size_t k = frames.size(); k-- > 0; ) {
+                    link(g, frames[k].u, *frames[k].next, local);
+                }
                 return true;
             }
+
+            down = cy[v];
+            break;
+        }
+
+        if(down != -1) {
+            frames.push_back(f);
+            nexts = g.getNexts(down);
+            f = Frame{down, nexts.begin(), nexts.end()};
+        }
+        else if(!frames.empty()) {
+            f = frames.back();
+            frames.pop_back();
+            f.next++;
+        }
+        else {
+            return false;
         }
     }
-    
-    return false;
+}
+
+// Matcher::rematch() but for the out header of 'v', see settle()
+void ParallelHopcroftKarpMatcher::link(const DenseRuleGraph &g, int u, int v, Local &local)
+{
+    in_header[v] = HeaderPool::instance().intersection(out_header[u], g.getInHeaderId(v));
+    cx[u] = v;
+    cy[v] = u;
+    local.moved.push_back(v);
+}
+
+// out headers of the rules rematched in the phase
+void ParallelHopcroftKarpMatcher::settle(const DenseRuleGraph &g)
+{
+    for(auto &local : locals) {
+        for(auto v : local.moved) {
+            reheader(g, v);
+        }
+        local.moved.clear();
+    }
+}
+
+void RepairMatcher::run(const DenseRuleGraph &g, vector<int> &match)
+{
+    HopcroftKarpMatcher::run(g, match);
+
+    int n = g.size();
+    prevs.assign(n, vector<pair<int, int>>());
+    for(int x = 0; x < n; x++) {
+        DenseRuleGraph::Nexts nexts = g.getNexts(x);
+        for(auto w = nexts.begin(); w != nexts.end(); w++) {
+            prevs[*w].push_back(make_pair(x, (int)g.getEdgeIndex(w)));
+        }
+    }
+    dirty.assign(n, 0);
+    ndropped = 0;
+    naugmented = 0;
+}
+
+void RepairMatcher::repair(const DenseRuleGraph &g, const vector<int> &changed, const vector<int> &removed, vector<int> &match, vector<pair<int, int>> &moved)
+{
+    const char X = 1, Y = 2, ROOT = 4, MOVED = 8, GONE = 16;
+    int n = g.size();
+    int old = cx.size();
+
+    // new rules come unmatched, the edges of replaced nexts untested
+    cx.resize(n, -1);
+    cy.resize(n, -1);
+    in_header.resize(n);
+    out_header.resize(n);
+    vis.resize(n, 0);
+    prevs.resize(n);
+    dirty.resize(n, GONE);
+    feas.resize(g.edges(), -1);
+    ndropped = 0;
+    naugmented = 0;
+    marked.clear();
+    rematched.clear();
+
+    auto mark = [&](int v, char flags) {
+        if(!(dirty[v] & ~GONE)) marked.push_back(v);
+        dirty[v] |= flags;
+    };
+    // what is left of the pair of 'x' is unmatched, and its 'y' gets its own
+    // headers back, which lets more edges out of it match
+    auto drop = [&](int x) {
+        int y = cx[x];
+        cx[x] = -1;
+        cy[y] = -1;
+        rematched.push_back(x);
+        ndropped++;
+        if(dirty[y] & GONE) return;
+
+        in_header[y] = g.getInHeaderId(y);
+        out_header[y] = g.getOutHeaderId(y);
+        DenseRuleGraph::Nexts nexts = g.getNexts(y);
+        fill(feas.begin() + g.getEdgeIndex(nexts.begin()), feas.begin() + g.getEdgeIndex(nexts.end()), -1);
+        mark(y, X | Y);
+    };
+
+    for(auto r : removed) {
+        dirty[r] |= GONE;
+    }
+    for(auto r : removed) {
+        if(cx[r] != -1) {
+            drop(r);
+        }
+        if(cy[r] != -1) {
+            int x = cy[r];
+            drop(x);
+            if(!(dirty[x] & GONE)) mark(x, X);
+        }
+    }
+
+    // rules with new nexts are dirty on the 'x' side, new ones on both with
+    // their own headers
+    for(auto x : changed) {
+        if(x >= old || (dirty[x] & GONE)) {
+            dirty[x] &= ~GONE;
+            in_header[x] = g.getInHeaderId(x);
+            out_header[x] = g.getOutHeaderId(x);
+            mark(x, X | Y);
+        }
+        else {
+            mark(x, X);
+        }
+
+        DenseRuleGraph::Nexts nexts = g.getNexts(x);
+        if(cx[x] != -1 && find(nexts.begin(), nexts.end(), cx[x]) == nexts.end()) {
+            drop(x);
+        }
+        for(auto w = nexts.begin(); w != nexts.end(); w++) {
+            prevs[*w].push_back(make_pair(x, (int)g.getEdgeIndex(w)));
+        }
+    }
+
+    // backwards from the dirty rules to the unmatched ones that can reach
+    // them: an 'x' rule is reached through its match, a 'y' rule from the
+    // rules with it in their nexts
+    int seen = stamp();
+    auto from = [&](int y) {
+        if(vis[y] != seen) {
+            vis[y] = seen;
+            q.push_back(y);
+        }
+    };
+    auto root = [&](int x) {
+        if(!(dirty[x] & ROOT)) {
+            mark(x, ROOT);
+            roots.push_back(x);
+        }
+    };
+    q.clear();
+    roots.clear();
+    for(size_t i = 0, k = marked.size(); i < k; i++) {
+        int v = marked[i];
+        if(dirty[v] & X) {
+            if(cx[v] == -1) root(v);
+            else from(cx[v]);
+        }
+        if(dirty[v] & Y) {
+            from(v);
+        }
+    }
+    for(size_t head = 0; head < q.size(); head++) {
+        int y = q[head];
+        vector<pair<int, int>> &in = prevs[y];
+        for(size_t k = 0; k < in.size(); ) {
+            int x = in[k].first;
+            size_t e = in[k].second;
+            DenseRuleGraph::Nexts nexts = g.getNexts(x);
+            if(e < g.getEdgeIndex(nexts.begin()) || e >= g.getEdgeIndex(nexts.end())) {
+                // the nexts of 'x' were replaced since
+                in[k] = in.back();
+                in.pop_back();
+                continue;
+            }
+            if(cx[x] == -1) root(x);
+            else from(cx[x]);
+            k++;
+        }
+    }
+    sort(roots.begin(), roots.end());
+
+    // a root that found no path finds none later either, and the rules a
+    // failed search went through lead nowhere until the next path is augmented
+    stamp();
+    for(auto r : roots) {
+        if(augment(g, r, [](int, int) { return true; })) {
+            naugmented++;
+            for(auto &f : stack) {
+                rematched.push_back(f.u);
+            }
+            stamp();
+        }
+    }
+
+    match.resize(n, -1);
+    moved.clear();
+    for(auto x : rematched) {
+        if(dirty[x] & MOVED) continue;
+        mark(x, MOVED);
+        if(match[x] != cx[x]) {
+            moved.push_back(make_pair(x, match[x]));
+            match[x] = cx[x];
+        }
+    }
+    for(auto v : marked) {
+        dirty[v] &= GONE;
+    }
+
+#ifdef VERBOSE
+    printf("[ ] matching repaired from %zu roots, %d pairs dropped, %d paths augmented\n", roots.size(), ndropped, naugmented);
+#endif
+}
+
+int RepairMatcher::dropped() const
+{
+    return ndropped;
+}
+
+int RepairMatcher::augmented() const
+{
+    return naugmented;
 }
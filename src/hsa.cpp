@@ -1,108 +1,337 @@
 #include "hsa.hpp"
 #include "structs.hpp"
 
-char HSA::get(const dynbitset &a, int ith)
+#include <cstddef>
+#include <cstring>
+#include <immintrin.h>
+
+// the kernels read a header as 'lo[WORDS]' directly followed by 'hi[WORDS]'
+static_assert(offsetof(Header, hi) == sizeof(uint64_t) * Header::WORDS, "unexpected header layout");
+
+bool HSA::toPrefix(const Header &h, Prefix &p)
 {
-    bool hi = a[2*ith + 1];
-    bool lo = a[2*ith];
+    // digits beyond the 32-bit address must be wildcards
+    for(size_t w = 0; w < h.words(); w++) {
+        uint64_t valid = (w + 1 < h.words()) ? ~(uint64_t)0 : h.tail();
+        if(w == 0) valid &= ~(uint64_t)0xffffffff;
+        if((h.lo[w] & h.hi[w] & valid) != valid) return false;
+    }
 
-    if(hi == 0 and lo == 0) return '-';
-    if(hi == 0 and lo == 1) return '0';
-    if(hi == 1 and lo == 0) return '1';
-    if(hi == 1 and lo == 1) return 'x';
+    // the address is fixed digits followed by a run of wildcards up to the LSB
+    uint64_t lo = h.lo[0] & 0xffffffff;
+    uint64_t hi = h.hi[0] & 0xffffffff;
+    uint64_t x = lo & hi;
+    if((lo | hi) != 0xffffffff || (x & (x + 1)) != 0) return false;
 
-    throw "undefined character. HSA::get() exits.";
+    p.len = 32 - __builtin_popcountll(x);
+    p.mask = ~x & 0xffffffff;
+    p.value = hi & p.mask;
+
+    return true;
 }
 
-    
-bool HSA::set(dynbitset &a, int ith, char ch)
+Header HSA::expand(const Prefix &p)
 {
-    if(ch == '0' && get(a, ith) == '1') return false;
-    if(ch == '1' && get(a, ith) == '0') return false;
-    
-    bool hi, lo;
-    if(ch == '-') { hi = 0; lo = 0; }
-    else if(ch == '0') { hi = 0; lo = 1; }
-    else if(ch == '1') { hi = 1; lo = 0; }
-    else if(ch == 'x') { hi = 1; lo = 1; }
-    else {
-        throw "undefined character. HSA::set() exits.";
+    Header h;
+    if(isEmpty(p)) {
+        return h;
     }
 
-    a[2*ith + 1] = hi;
-    a[2*ith] = lo;
+    for(size_t w = 0; w < h.words(); w++) {
+        h.lo[w] = h.hi[w] = (w + 1 < h.words()) ? ~(uint64_t)0 : h.tail();
+    }
+
+    uint64_t m = p.mask;
+    h.lo[0] &= ~(m & p.value);
+    h.hi[0] &= ~(m & ~p.value);
+
+    return h;
+}
+
+static bool ParseIPv4(const char *&p, const char *last, uint32_t &addr)
+{
+    addr = 0;
+    for(int part = 0; part < 4; part++) {
+        if(part > 0) {
+            if(p == last || *p != '.') return false;
+            p++;
+        }
+
+        unsigned octet = 0;
+        const char *digits = p;
+        while(p != last && *p >= '0' && *p <= '9' && p - digits < 3) {
+            octet = octet * 10 + (*p++ - '0');
+        }
+        if(p == digits || octet > 255) return false;
+
+        addr = addr << 8 | octet;
+    }
 
     return true;
 }
-    
-dynbitset HSA::intersection(const dynbitset &a, const dynbitset &b)
+
+static int HexDigit(char ch)
 {
-    return a & b;
+    if(ch >= '0' && ch <= '9') return ch - '0';
+    if(ch >= 'a' && ch <= 'f') return ch - 'a' + 10;
+    if(ch >= 'A' && ch <= 'F') return ch - 'A' + 10;
+    return -1;
 }
 
-bool HSA::isEmpty(const dynbitset &a)
+// 'addr[0]' holds the high 64 bits
+static bool ParseIPv6(const char *&p, const char *last, uint64_t addr[2])
 {
-    for(size_t ith = 0; ith < a.size() / 2; ith++) {
-        if(get(a, ith) == '-') {
-            return true;
+    uint16_t groups[8];
+    int n = 0, gap = -1;    // 'gap' is where '::' stands
+
+    if(last - p >= 2 && p[0] == ':' && p[1] == ':') {
+        gap = 0;
+        p += 2;
+    }
+
+    while(p != last && *p != '/' && n < 8) {
+        // an embedded IPv4 address takes the last two groups
+        const char *q = p;
+        while(q != last && HexDigit(*q) >= 0) q++;
+        if(q != last && *q == '.') {
+            uint32_t v4;
+            if(n > 6 || !ParseIPv4(p, last, v4)) return false;
+            groups[n++] = v4 >> 16;
+            groups[n++] = v4 & 0xffff;
+            break;
+        }
+
+        unsigned group = 0;
+        const char *digits = p;
+        while(p != last && HexDigit(*p) >= 0 && p - digits < 4) {
+            group = group << 4 | HexDigit(*p++);
+        }
+        if(p == digits) return false;
+        groups[n++] = group;
+
+        if(p == last || *p == '/') break;
+        if(*p++ != ':') return false;
+        if(p != last && *p == ':') {
+            if(gap != -1) return false;
+            gap = n;
+            p++;
+        }
+        else if(p == last || *p == '/') {
+            // a single ':' is followed by another group
+            return false;
         }
     }
 
-    return false;
+    if(gap == -1 ? n != 8 : n > 7) return false;
+
+    // expand '::' with zero groups
+    uint16_t full[8] = {0};
+    int tail = (gap == -1) ? 0 : n - gap;
+    for(int i = 0; i < n - tail; i++) full[i] = groups[i];
+    for(int i = 0; i < tail; i++) full[8 - tail + i] = groups[n - tail + i];
+
+    addr[0] = addr[1] = 0;
+    for(int i = 0; i < 8; i++) {
+        addr[i / 4] = addr[i / 4] << 16 | full[i];
+    }
+
+    return true;
 }
 
-bool HSA::matchable(const dynbitset &a, const dynbitset &b)
+Header HSA::translate(const char *first, const char *last)
 {
-    return !isEmpty(intersection(a, b));
+    const char *p = first;
+    bool v6 = false;
+    for(const char *q = first; q != last && *q != '/'; q++) {
+        if(*q == ':') { v6 = true; break; }
+    }
+
+    uint32_t v4 = 0;
+    uint64_t addr[2];
+    if(v6 ? !ParseIPv6(p, last, addr) : !ParseIPv4(p, last, v4)) {
+        throw "malformed prefix. HSA::translate() exits.";
+    }
+
+    int width = v6 ? 128 : 32;
+    int mask_l = width;
+    if(p != last) {
+        if(*p++ != '/' || p == last) {
+            throw "malformed prefix. HSA::translate() exits.";
+        }
+        mask_l = 0;
+        while(p != last && *p >= '0' && *p <= '9' && mask_l <= width) {
+            mask_l = mask_l * 10 + (*p++ - '0');
+        }
+        if(p != last || mask_l > width) {
+            throw "malformed prefix. HSA::translate() exits.";
+        }
+    }
+
+    if(!v6) {
+        uint32_t mask = (uint32_t)(~(uint64_t)0 << (32 - mask_l));
+        return expand(Prefix{v4 & mask, mask, mask_l});
+    }
+
+    if(HEADER_BITS < 128) {
+        throw "IPv6 prefix needs HEADER_BITS >= 128. HSA::translate() exits.";
+    }
+
+    // digits beyond the 128-bit address are wildcards
+    Header header;
+    for(size_t w = 0; w < header.words(); w++) {
+        header.lo[w] = header.hi[w] = (w + 1 < header.words()) ? ~(uint64_t)0 : header.tail();
+    }
+
+    // the first 'mask_l' bits are fixed, digit 0 is the LSB of the address
+    for(size_t w = 0; w < 2 && w < header.words(); w++) {
+        uint64_t value = addr[1 - w];
+        int fixed = mask_l - 64 * (1 - (int)w);     // fixed bits from the top of this word
+        uint64_t m = fixed <= 0 ? 0 : fixed >= 64 ? ~(uint64_t)0 : ~(uint64_t)0 << (64 - fixed);
+        header.lo[w] &= ~(m & value);
+        header.hi[w] &= ~(m & ~value);
+    }
+
+    return header;
 }
-  
-dynbitset HSA::translate(const string &prefix)
+
+Header HSA::translate(const string &prefix)
 {
-    string ip;
-    int mask_l;
-    size_t pos = prefix.find('/');
-    
-    if(pos == string::npos) {
-        ip = prefix;
-        mask_l = 32;
-    }
-    else {
-        ip = prefix.substr(0, pos);
-        mask_l = stoi(prefix.substr(pos + 1));
-    }
-
-    // convert ip to binary string
-    string binstr;
-
-    ip += '.';
-    do {
-        pos = ip.find('.');
-        int part = stoi(ip.substr(0, pos));
-        
-        // from MSB to LSB
-        for(int ct = 0; ct < 8; ct++) {
-            binstr += (part >> (7-ct) & 1) ? '1' : '0'; 
+    return translate(prefix.data(), prefix.data() + prefix.size());
+}
+
+void HSA::translate(const vector<string> &prefixes, vector<Header> &headers)
+{
+    headers.resize(prefixes.size());
+    for(size_t i = 0; i < prefixes.size(); i++) {
+        headers[i] = translate(prefixes[i].data(), prefixes[i].data() + prefixes[i].size());
+    }
+}
+
+static void MatchScalar(const Header &a, const Header *bs, size_t n, uint64_t *mask)
+{
+    for(size_t w = 0; w < (n + 63) / 64; w++) {
+        uint64_t m = 0;
+        for(size_t i = w * 64; i < n && i < (w + 1) * 64; i++) {
+            m |= (uint64_t)HSA::matchable(a, bs[i]) << (i % 64);
         }
-        
-        ip = ip.substr(pos + 1);
-    } while(ip != "");
+        mask[w] = m;
+    }
+}
+
+__attribute__((target("avx2")))
+static void MatchAVX2(const Header &a, const Header *bs, size_t n, uint64_t *mask)
+{
+    memset(mask, 0, (n + 63) / 64 * sizeof(uint64_t));
+
+    const uint64_t *p = bs->lo;
+    const __m256i ones = _mm256_set1_epi64x(-1);
+    size_t i = 0;
 
-    // set header based on the binary (little endian)
-    dynbitset header(64);
-    for(int ith = 0; ith < 32; ith++) {
-        char ch = (ith < (32-mask_l)) ? 'x' : binstr[31-ith];
-        set(header, ith, ch);
+    if(Header::WORDS == 1) {
+        // 4 headers per step: [lo0 hi0 lo1 hi1] [lo2 hi2 lo3 hi3]
+        const __m256i va = _mm256_set_epi64x(a.hi[0], a.lo[0], a.hi[0], a.lo[0]);
+        const __m256i pad = _mm256_set1_epi64x(~a.tail());
+        for(; i + 4 <= n; i += 4) {
+            __m256i v0 = _mm256_and_si256(_mm256_loadu_si256((const __m256i *)(p + 2*i)), va);
+            __m256i v1 = _mm256_and_si256(_mm256_loadu_si256((const __m256i *)(p + 2*i + 4)), va);
+            // [r0 r2 r1 r3] -> [r0 r1 r2 r3]
+            __m256i r = _mm256_or_si256(_mm256_unpacklo_epi64(v0, v1), _mm256_unpackhi_epi64(v0, v1));
+            r = _mm256_permute4x64_epi64(_mm256_or_si256(r, pad), 0xD8);
+            uint64_t m = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(r, ones)));
+            mask[i / 64] |= m << (i % 64);
+        }
+    }
+    else if(Header::WORDS == 2) {
+        // 2 headers per step: [lo0 lo1 hi0 hi1] [lo0' lo1' hi0' hi1']
+        const __m256i va = _mm256_loadu_si256((const __m256i *)a.lo);
+        const __m256i pad = _mm256_set_epi64x(~a.tail(), 0, ~a.tail(), 0);
+        for(; i + 2 <= n; i += 2) {
+            __m256i v0 = _mm256_and_si256(_mm256_loadu_si256((const __m256i *)(p + 4*i)), va);
+            __m256i v1 = _mm256_and_si256(_mm256_loadu_si256((const __m256i *)(p + 4*i + 4)), va);
+            __m256i r = _mm256_or_si256(_mm256_permute2x128_si256(v0, v1, 0x20), _mm256_permute2x128_si256(v0, v1, 0x31));
+            int m = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(_mm256_or_si256(r, pad), ones)));
+            // 'i' is even, so both headers land in the same mask word
+            mask[i / 64] |= (uint64_t)(((m & 0x3) == 0x3) | ((m & 0xc) == 0xc) << 1) << (i % 64);
+        }
+    }
+
+    for(; i < n; i++) {
+        mask[i / 64] |= (uint64_t)HSA::matchable(a, bs[i]) << (i % 64);
     }
-    
-    return header;
 }
 
-string HSA::stringify(const dynbitset &header)
+__attribute__((target("avx512f")))
+static void MatchAVX512(const Header &a, const Header *bs, size_t n, uint64_t *mask)
 {
-    string str;
-    for(size_t ith = 0; ith < header.size() / 2; ith++) {
-        str = get(header, ith) + str;   // little endian
+    memset(mask, 0, (n + 63) / 64 * sizeof(uint64_t));
+
+    const uint64_t *p = bs->lo;
+    const __m512i ones = _mm512_set1_epi64(-1);
+    size_t i = 0;
+
+    if(Header::WORDS == 1) {
+        // 8 headers per step, gather the lo and hi planes of all eight
+        const __m512i va = _mm512_set_epi64(a.hi[0], a.lo[0], a.hi[0], a.lo[0], a.hi[0], a.lo[0], a.hi[0], a.lo[0]);
+        const __m512i pad = _mm512_set1_epi64(~a.tail());
+        const __m512i ilo = _mm512_set_epi64(14, 12, 10, 8, 6, 4, 2, 0);
+        const __m512i ihi = _mm512_set_epi64(15, 13, 11, 9, 7, 5, 3, 1);
+        for(; i + 8 <= n; i += 8) {
+            __m512i v0 = _mm512_and_si512(_mm512_loadu_si512(p + 2*i), va);
+            __m512i v1 = _mm512_and_si512(_mm512_loadu_si512(p + 2*i + 8), va);
+            __m512i r = _mm512_or_si512(_mm512_permutex2var_epi64(v0, ilo, v1), _mm512_permutex2var_epi64(v0, ihi, v1));
+            uint64_t m = _mm512_cmpeq_epi64_mask(_mm512_or_si512(r, pad), ones);
+            mask[i / 64] |= m << (i % 64);
+        }
     }
+    else if(Header::WORDS == 2) {
+        // 4 headers per step, gather the lo and hi planes of all four
+        const uint64_t *q = a.lo;
+        const __m512i va = _mm512_set_epi64(q[3], q[2], q[1], q[0], q[3], q[2], q[1], q[0]);
+        const __m512i pad = _mm512_set_epi64(~a.tail(), 0, ~a.tail(), 0, ~a.tail(), 0, ~a.tail(), 0);
+        const __m512i ilo = _mm512_set_epi64(13, 12, 9, 8, 5, 4, 1, 0);
+        const __m512i ihi = _mm512_set_epi64(15, 14, 11, 10, 7, 6, 3, 2);
+        for(; i + 4 <= n; i += 4) {
+            __m512i v0 = _mm512_and_si512(_mm512_loadu_si512(p + 4*i), va);
+            __m512i v1 = _mm512_and_si512(_mm512_loadu_si512(p + 4*i + 8), va);
+            __m512i r = _mm512_or_si512(_mm512_permutex2var_epi64(v0, ilo, v1), _mm512_permutex2var_epi64(v0, ihi, v1));
+            unsigned m = _mm512_cmpeq_epi64_mask(_mm512_or_si512(r, pad), ones);
+            // header j matches iff both of its words are full (bits 2j and 2j+1)
+            m &= m >> 1;
+            m = (m & 0x1) | (m >> 1 & 0x2) | (m >> 2 & 0x4) | (m >> 3 & 0x8);
+            mask[i / 64] |= (uint64_t)m << (i % 64);
+        }
+    }
+
+    for(; i < n; i++) {
+        mask[i / 64] |= (uint64_t)HSA::matchable(a, bs[i]) << (i % 64);
+    }
+}
 
-    return str;
+HSA::MatchKernel HSA::kernel(const string &isa)
+{
+    // vector kernels cover rule headers of up to 128 digits
+    bool wide = Header::WORDS > 2;
+
+    if(isa == "scalar") {
+        return MatchScalar;
+    }
+    if(isa == "avx2") {
+        return (!wide && __builtin_cpu_supports("avx2")) ? MatchAVX2 : nullptr;
+    }
+    if(isa == "avx512") {
+        return (!wide && __builtin_cpu_supports("avx512f")) ? MatchAVX512 : nullptr;
+    }
+    if(isa.empty()) {
+        if(kernel("avx512")) return MatchAVX512;
+        if(kernel("avx2")) return MatchAVX2;
+        return MatchScalar;
+    }
+
+    throw "undefined instruction set. HSA::kernel() exits.";
+}
+
+void HSA::matchable(const Header &a, const Header *bs, size_t n, uint64_t *mask)
+{
+    static const MatchKernel best = kernel("");
+    best(a, bs, n, mask);
 }
@@ -5,16 +5,141 @@
 
 class HSA {
 public:
-    static char get(const dynbitset &a, int ith);   
-    static bool set(dynbitset &a, int ith, char ch);
-    
-    static dynbitset intersection(const dynbitset &a, const dynbitset &b);
-    static bool isEmpty(const dynbitset &a);
-    static bool matchable(const dynbitset &a, const dynbitset &b);
-    
-    static dynbitset translate(const string &prefix);
-    static string stringify(const dynbitset &header);
+    template<size_t N> static char get(const Ternary<N> &a, int ith);
+    template<size_t N> static bool set(Ternary<N> &a, int ith, char ch);
+
+    template<size_t N> static Ternary<N> intersection(const Ternary<N> &a, const Ternary<N> &b);
+    template<size_t N> static bool isEmpty(const Ternary<N> &a);
+    template<size_t N> static bool matchable(const Ternary<N> &a, const Ternary<N> &b);
+
+    // batch test of 'a' against 'bs[0..n)', bit i of 'mask' is set iff a matches bs[i]
+    typedef void (*MatchKernel)(const Header &a, const Header *bs, size_t n, uint64_t *mask);
+    static void matchable(const Header &a, const Header *bs, size_t n, uint64_t *mask);
+    // kernel by instruction set: scalar|avx2|avx512, or the best supported one if empty
+    // (null if the cpu or the header width doesn't support it)
+    static MatchKernel kernel(const string &isa);
+
+    // fast paths for headers that are pure IPv4 prefixes
+    static bool toPrefix(const Header &h, Prefix &p);
+    static Header expand(const Prefix &p);
+    static Prefix intersection(const Prefix &a, const Prefix &b);
+    static bool isEmpty(const Prefix &a);
+    static bool matchable(const Prefix &a, const Prefix &b);
+
+    // IPv4 or IPv6 prefix, parsed in place without allocation
+    static Header translate(const char *first, const char *last);
+    static Header translate(const string &prefix);
+    static void translate(const vector<string> &prefixes, vector<Header> &headers);
+    template<size_t N> static string stringify(const Ternary<N> &header);
 };
 
-#endif
+template<size_t N>
+char HSA::get(const Ternary<N> &a, int ith)
+{
+    bool hi = a.hi[ith / 64] >> (ith % 64) & 1;
+    bool lo = a.lo[ith / 64] >> (ith % 64) & 1;
+
+    if(hi == 0 and lo == 0) return '-';
+    if(hi == 0 and lo == 1) return '0';
+    if(hi == 1 and lo == 0) return '1';
+    if(hi == 1 and lo == 1) return 'x';
+
+    throw "undefined character. HSA::get() exits.";
+}
+
+template<size_t N>
+bool HSA::set(Ternary<N> &a, int ith, char ch)
+{
+    if(ch == '0' && get(a, ith) == '1') return false;
+    if(ch == '1' && get(a, ith) == '0') return false;
+
+    bool hi, lo;
+    if(ch == '-') { hi = 0; lo = 0; }
+    else if(ch == '0') { hi = 0; lo = 1; }
+    else if(ch == '1') { hi = 1; lo = 0; }
+    else if(ch == 'x') { hi = 1; lo = 1; }
+    else {
+        throw "undefined character. HSA::set() exits.";
+    }
+
+    uint64_t bit = (uint64_t)1 << (ith % 64);
+    a.hi[ith / 64] = hi ? (a.hi[ith / 64] | bit) : (a.hi[ith / 64] & ~bit);
+    a.lo[ith / 64] = lo ? (a.lo[ith / 64] | bit) : (a.lo[ith / 64] & ~bit);
+
+    return true;
+}
+
+template<size_t N>
+Ternary<N> HSA::intersection(const Ternary<N> &a, const Ternary<N> &b)
+{
+    Ternary<N> c = a;
+    for(size_t w = 0; w < a.words(); w++) {
+        c.lo[w] &= b.lo[w];
+        c.hi[w] &= b.hi[w];
+    }
 
+    return c;
+}
+
+template<size_t N>
+bool HSA::isEmpty(const Ternary<N> &a)
+{
+    // a digit is empty iff neither of its planes is set, so test 64 digits at a time
+    size_t nw = a.words();
+    for(size_t w = 0; w + 1 < nw; w++) {
+        if(~(a.lo[w] | a.hi[w])) {
+            return true;
+        }
+    }
+
+    return nw > 0 && (~(a.lo[nw-1] | a.hi[nw-1]) & a.tail());
+}
+
+template<size_t N>
+bool HSA::matchable(const Ternary<N> &a, const Ternary<N> &b)
+{
+    // !isEmpty(intersection(a, b)) without building the intersection
+    size_t nw = a.words();
+    for(size_t w = 0; w < nw; w++) {
+        uint64_t pad = (w + 1 < nw) ? 0 : ~a.tail();
+        if(~((a.lo[w] & b.lo[w]) | (a.hi[w] & b.hi[w]) | pad)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+inline bool HSA::isEmpty(const Prefix &a)
+{
+    return a.len < 0;
+}
+
+inline bool HSA::matchable(const Prefix &a, const Prefix &b)
+{
+    // two prefixes overlap iff the shorter one contains the longer one
+    // netmasks are nested, so 'a.mask & b.mask' is the mask of the shorter one
+    return ((a.len | b.len) >= 0) & (((a.value ^ b.value) & a.mask & b.mask) == 0);
+}
+
+inline Prefix HSA::intersection(const Prefix &a, const Prefix &b)
+{
+    if(!matchable(a, b)) {
+        return Prefix{0, 0, -1};
+    }
+
+    return a.len > b.len ? a : b;
+}
+
+template<size_t N>
+string HSA::stringify(const Ternary<N> &header)
+{
+    string str(header.size(), '-');
+    for(size_t ith = 0; ith < header.size(); ith++) {
+        str[header.size() - 1 - ith] = get(header, ith);   // little endian
+    }
+
+    return str;
+}
+
+#endif
@@ -1,30 +1,105 @@
 #include "io.hpp"
+#include "trie.hpp"
+#include "threads.hpp"
+#include "stream.hpp"
+
+#include <cstring>
+#include <type_traits>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// below this many candidates a linear scan beats building a trie
+#define TRIE_MIN_RULES 64
+
+/*
+ * Binary topology (.btopo), written by IO::ConvertTopo and mapped by
+ * IO::LoadTopo. Sections follow each other, each padded to 8 bytes:
+ *   TopoFileHeader
+ *   int32_t     sids[ns]            switches in file order
+ *   uint32_t    nbr_offs[ns + 1]    neighbors of sids[i] are nbrs[nbr_offs[i], nbr_offs[i+1])
+ *   int32_t     nbrs[nn]
+ *   TopoRecord  rules[nr]           non-edge rules, grouped by switch in file order
+ *   Header      headers[nr]         translated prefix of each rule
+ *   char        text[nt]            prefix of each rule as written in the .topo
+ * Headers are stored as laid out in memory, so a file is only valid for
+ * the HEADER_BITS (and byte order) it was converted with.
+ */
+#define TOPO_MAGIC "VOYTOPO"
+#define TOPO_VERSION 1
+
+struct TopoFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t header_bits;
+    uint32_t ns;
+    uint32_t nn;
+    uint32_t nr;
+    uint32_t nt;
+};
+
+struct TopoRecord {
+    int32_t rid;
+    int32_t sid;
+    int32_t in_port;
+    int32_t out_port;
+    int32_t priority;
+    uint32_t text_off;
+    uint32_t text_len;
+    uint32_t pad;
+};
+
+static_assert(is_trivially_copyable<Header>::value, "Header must be trivially copyable to be mapped.");
+
+static size_t Align8(size_t n)
+{
+    return (n + 7) & ~(size_t)7;
+}
+
+// byte offsets of the sections after the file header, and the total size
+struct TopoLayout {
+    size_t sids, nbr_offs, nbrs, rules, headers, text, size;
+
+    TopoLayout(const TopoFileHeader &fh) {
+        sids = Align8(sizeof(TopoFileHeader));
+        nbr_offs = Align8(sids + sizeof(int32_t) * fh.ns);
+        nbrs = Align8(nbr_offs + sizeof(uint32_t) * ((size_t)fh.ns + 1));
+        rules = Align8(nbrs + sizeof(int32_t) * fh.nn);
+        headers = Align8(rules + sizeof(TopoRecord) * fh.nr);
+        text = Align8(headers + sizeof(Header) * fh.nr);
+        size = text + fh.nt;
+    }
+};
+
+static bool HasSuffix(const string &name, const string &suffix)
+{
+    return name.size() >= suffix.size() && name.compare(name.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+string IO::Stem(const string &name)
+{
+    string stem = HasSuffix(name, ".gz") ? name.substr(0, name.size() - 3) : name;
+    size_t dot = stem.rfind('.');
+    if(dot != string::npos && stem.find('/', dot) == string::npos) {
+        stem.erase(dot);
+    }
+
+    return stem;
+}
 
 void IO::LoadTopo(const string &name, SwitchGraph &sg, RuleGraph &rg)
 {
-    ifstream fin("../data/topo/" + name);
-    if(!fin) {
-        throw "topo file does not exist.";
+    if(HasSuffix(name, ".btopo")) {
+        LoadBinaryTopo(name, sg, rg);
     }
-    
-    // build switch graph
-    int ns;
-    fin >> ns;
-    
-    int sid, neighbor;
-    for(int idx = 0; idx < ns; idx++) {
-        fin >> sid;
-        sg[sid] = SwitchNode(sid, idx);
-        
-        while(fin.get() != '\n') {
-            fin >> neighbor;
-            sg[sid].addNeighbor(neighbor);
-        }
+    else {
+        LoadTextTopo(name, sg, rg);
     }
-    
+
 #ifdef VERBOSE
     printf("[ ] %ld switches as below:\n", sg.size());
-    for(auto it : sg) {
+    for(auto &it : sg) {
         int s1 = it.first;
         printf("    - %d -", s1);
         for(auto s2 : sg[s1].getNeighbors()) {
@@ -32,29 +107,9 @@ void IO::LoadTopo(const string &name, SwitchGraph &sg, RuleGraph &rg)
         }
         printf("\n");
     }
-#endif
-    
-    // add rules
-    int nr;
-    while(ns--) {
-        fin >> sid >> nr;
-        while(nr--) {
-            int rid;
-            string prefix;
-            int in_port, out_port, priority;
-            fin >> rid >> prefix >> in_port >> out_port >> priority;
-            // skip edge rules
-            if(out_port == PORT_HOST) {
-                continue;
-            }
-            rg[rid] = RuleNode(rid, sid, prefix, in_port, out_port, priority);
-            sg[sid].addRule(rid);
-        }
-    }
 
-#ifdef VERBOSE
     printf("[ ] %ld rules as below:\n", rg.size());
-    for(auto it : sg) {
+    for(auto &it : sg) {
         int s = it.first;
         printf("    - %d -", s);
         for(auto r : sg[s].getRules()) {
@@ -65,30 +120,11 @@ void IO::LoadTopo(const string &name, SwitchGraph &sg, RuleGraph &rg)
 #endif
 
     // build rule graph
-    for(auto it : sg)  {
-        int s1 = it.first;
-        for(auto s2 : sg.at(s1).getNeighbors()) {
-            // for r1 on s1 pointing to s2
-            for(auto r1 : sg.at(s1).getRules()) {
-                Rule rule1 = rg.at(r1).getRule(); 
-                if(rule1.getOutPort() != s2) continue;
-                // for r2 on s2 pointed by s1
-                for(auto r2 : sg.at(s2).getRules()) {
-                    Rule rule2 = rg.at(r2).getRule(); 
-                    if(rule2.getInPort() != s1) continue;
-                    // build a directed edge if two neighboring rules match
-
-                    if(HSA::matchable(rule1.getOutHeader(), rule2.getInHeader())) {
-                        rg[r1].addNext(r2);
-                    }
-                }
-            }
-        }
-    }
+    BuildRuleGraph(sg, rg);
 
 #ifdef VERBOSE
     printf("[ ] rule graph as below:\n");
-    for(auto it : rg) {
+    for(auto &it : rg) {
         int r1 = it.first;
         printf("    - %d -", r1);
         for(auto r2 : rg[r1].getNexts()) {
@@ -99,9 +135,426 @@ void IO::LoadTopo(const string &name, SwitchGraph &sg, RuleGraph &rg)
 #endif
 }
 
+// cursor over text loaded in memory
+struct TextCursor {
+    const char *p;
+    const char *end;
+
+    // skip blanks on this line, true if nothing else is left on it
+    bool eol() {
+        while(p < end && (*p == ' ' || *p == '\t' || *p == '\r')) p++;
+        return p == end || *p == '\n';
+    }
+
+    // next whitespace separated token, possibly on a following line
+    void token(const char *&first, const char *&last) {
+        while(p < end && (unsigned char)*p <= ' ') p++;
+        first = p;
+        while(p < end && (unsigned char)*p > ' ') p++;
+        last = p;
+        if(first == last) {
+            throw "malformed file. TextCursor::token() exits.";
+        }
+    }
+
+    int integer() {
+        const char *first, *last;
+        token(first, last);
+        bool neg = (*first == '-');
+        int v = 0;
+        for(const char *c = first + neg; c < last; c++) {
+            if(*c < '0' || *c > '9') {
+                throw "malformed file. TextCursor::integer() exits.";
+            }
+            v = v * 10 + (*c - '0');
+        }
+        if(first + neg == last) {
+            throw "malformed file. TextCursor::integer() exits.";
+        }
+        return neg ? -v : v;
+    }
+
+    void nextLine() {
+        const char *nl = (const char*)memchr(p, '\n', end - p);
+        p = nl ? nl + 1 : end;
+    }
+};
+
+// a rule parsed by a worker, added to the rule graph afterwards
+struct TextRule {
+    int rid;
+    int in_port;
+    int out_port;
+    int priority;
+    const char *first;  // prefix, valid until the next chunk
+    const char *last;
+    Header header;
+};
+
+// consecutive rule lines of one switch within a chunk
+struct TextSegment {
+    int sid;
+    TextCursor text;
+    vector<TextRule> rules;
+};
+
+// rules per segment, so that a switch with many rules is parsed by many threads
+#define SEGMENT_RULES 4096
+
+/*
+ * Parse a text topology chunk by chunk. The switch section is parsed as it
+ * comes. Rule lines are cut into segments that the thread pool parses and
+ * translates, and the segments are handed to 'on_rules' in file order. The
+ * LineReader inflates the next chunk meanwhile.
+ */
+static void ParseTextTopo(const string &path,
+                          const function<void(int sid, int idx, vector<int> &neighbors)> &on_switch,
+                          const function<void(int sid, vector<TextRule> &rules)> &on_rules)
+{
+    LineReader reader(path);
+    if(!reader.good()) {
+        throw "topo file does not exist.";
+    }
+
+    enum {NUM_SWITCHES, SWITCHES, BLOCK, RULES, DONE} state = NUM_SWITCHES;
+    int ns = 0, idx = 0, blocks = 0, nr = 0, sid = 0;
+    vector<int> neighbors;
+    vector<TextSegment> segments;
+
+    string chunk;
+    while(state != DONE && reader.next(chunk)) {
+        TextCursor cur = {chunk.data(), chunk.data() + chunk.size()};
+        segments.clear();
+
+        while(state != DONE && cur.p < cur.end) {
+            if(cur.eol()) {
+                cur.nextLine();     // blank line
+                continue;
+            }
+
+            switch(state) {
+            case NUM_SWITCHES:
+                ns = blocks = cur.integer();
+                cur.nextLine();
+                state = ns > 0 ? SWITCHES : DONE;
+                break;
+
+            case SWITCHES:
+                // switch ID, neighbor IDs
+                sid = cur.integer();
+                neighbors.clear();
+                while(!cur.eol()) {
+                    neighbors.push_back(cur.integer());
+                }
+                cur.nextLine();
+                on_switch(sid, idx, neighbors);
+                state = (++idx < ns) ? SWITCHES : BLOCK;
+                break;
+
+            case BLOCK:
+                // switch ID, number of rules
+                sid = cur.integer();
+                nr = cur.integer();
+                cur.nextLine();
+                blocks--;
+                state = nr > 0 ? RULES : (blocks > 0 ? BLOCK : DONE);
+                break;
+
+            case RULES: {
+                // one rule per line
+                TextSegment seg;
+                seg.sid = sid;
+                seg.text.p = cur.p;
+                int n = 0;
+                while(cur.p < cur.end && n < nr && n < SEGMENT_RULES) {
+                    n += !cur.eol();
+                    cur.nextLine();
+                }
+                seg.text.end = cur.p;
+                segments.push_back(seg);
+                nr -= n;
+                state = nr > 0 ? RULES : (blocks > 0 ? BLOCK : DONE);
+                break;
+            }
+
+            case DONE:
+                break;
+            }
+        }
+
+        // parse and translate segments in parallel
+        ThreadPool::instance().run(segments.size(), [&](size_t i) {
+            TextCursor sc = segments[i].text;
+            while(sc.p < sc.end) {
+                if(sc.eol()) {
+                    sc.nextLine();
+                    continue;
+                }
+                TextRule r;
+                r.rid = sc.integer();
+                sc.token(r.first, r.last);
+                r.in_port = sc.integer();
+                r.out_port = sc.integer();
+                r.priority = sc.integer();
+                sc.nextLine();
+                // skip edge rules
+                if(r.out_port == PORT_HOST) {
+                    continue;
+                }
+                r.header = HSA::translate(r.first, r.last);
+                segments[i].rules.push_back(r);
+            }
+        });
+
+        for(auto &seg : segments) {
+            on_rules(seg.sid, seg.rules);
+        }
+    }
+
+    if(state != DONE) {
+        throw "truncated topo file. IO::LoadTopo() exits.";
+    }
+}
+
+void IO::LoadTextTopo(const string &name, SwitchGraph &sg, RuleGraph &rg)
+{
+    // build switch graph and add rules in file order
+    ParseTextTopo("../data/topo/" + name,
+        [&](int sid, int idx, vector<int> &neighbors) {
+            sg[sid] = SwitchNode(sid, idx);
+            for(auto neighbor : neighbors) {
+                sg[sid].addNeighbor(neighbor);
+            }
+        },
+        [&](int sid, vector<TextRule> &rules) {
+            for(auto &r : rules) {
+                rg[r.rid] = RuleNode(r.rid, sid, string(r.first, r.last), r.header, r.in_port, r.out_port, r.priority);
+                sg[sid].addRule(r.rid);
+            }
+        });
+}
+
+void IO::LoadBinaryTopo(const string &name, SwitchGraph &sg, RuleGraph &rg)
+{
+    string path = "../data/topo/" + name;
+    int fd = open(path.c_str(), O_RDONLY);
+    if(fd < 0) {
+        throw "topo file does not exist.";
+    }
+
+    struct stat st;
+    if(fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(TopoFileHeader)) {
+        close(fd);
+        throw "truncated binary topo file. IO::LoadBinaryTopo() exits.";
+    }
+
+    size_t size = st.st_size;
+    void *base = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(base == MAP_FAILED) {
+        throw "cannot map binary topo file. IO::LoadBinaryTopo() exits.";
+    }
+
+    const char *data = (const char*)base;
+    const TopoFileHeader &fh = *(const TopoFileHeader*)data;
+    const char *err = nullptr;
+    if(memcmp(fh.magic, TOPO_MAGIC, sizeof(fh.magic)) != 0 || fh.version != TOPO_VERSION) {
+        err = "not a binary topo file of this version. IO::LoadBinaryTopo() exits.";
+    }
+    else if(fh.header_bits != HEADER_BITS) {
+        err = "binary topo file converted with another HEADER_BITS. IO::LoadBinaryTopo() exits.";
+    }
+    else if(TopoLayout(fh).size > size) {
+        err = "truncated binary topo file. IO::LoadBinaryTopo() exits.";
+    }
+    if(err) {
+        munmap(base, size);
+        throw err;
+    }
+
+    TopoLayout layout(fh);
+    const int32_t *sids = (const int32_t*)(data + layout.sids);
+    const uint32_t *nbr_offs = (const uint32_t*)(data + layout.nbr_offs);
+    const int32_t *nbrs = (const int32_t*)(data + layout.nbrs);
+    const TopoRecord *rules = (const TopoRecord*)(data + layout.rules);
+    const Header *headers = (const Header*)(data + layout.headers);
+    const char *text = data + layout.text;
+
+    // build switch graph
+    for(uint32_t idx = 0; idx < fh.ns; idx++) {
+        int sid = sids[idx];
+        sg[sid] = SwitchNode(sid, idx);
+        for(uint32_t n = nbr_offs[idx]; n < nbr_offs[idx + 1] && n < fh.nn; n++) {
+            sg[sid].addNeighbor(nbrs[n]);
+        }
+    }
+
+    // add rules, taking headers as they are
+    for(uint32_t i = 0; i < fh.nr; i++) {
+        const TopoRecord &r = rules[i];
+        if((size_t)r.text_off + r.text_len > fh.nt) {
+            munmap(base, size);
+            throw "corrupted binary topo file. IO::LoadBinaryTopo() exits.";
+        }
+        string prefix(text + r.text_off, r.text_len);
+        rg[r.rid] = RuleNode(r.rid, r.sid, prefix, headers[i], r.in_port, r.out_port, r.priority);
+        sg[r.sid].addRule(r.rid);
+    }
+
+    munmap(base, size);
+}
+
+void IO::ConvertTopo(const string &name)
+{
+    TopoFileHeader fh;
+    memset(&fh, 0, sizeof(fh));
+    memcpy(fh.magic, TOPO_MAGIC, sizeof(fh.magic));
+    fh.version = TOPO_VERSION;
+    fh.header_bits = HEADER_BITS;
+
+    // switch graph, and rules without edge rules as LoadTopo skips them anyway
+    vector<int32_t> sids;
+    vector<uint32_t> nbr_offs = {0};
+    vector<int32_t> nbrs;
+    vector<TopoRecord> rules;
+    vector<Header> headers;
+    string text;
+    ParseTextTopo("../data/topo/" + name,
+        [&](int sid, int idx, vector<int> &neighbors) {
+            sids.push_back(sid);
+            nbrs.insert(nbrs.end(), neighbors.begin(), neighbors.end());
+            nbr_offs.push_back(nbrs.size());
+        },
+        [&](int sid, vector<TextRule> &parsed) {
+            for(auto &p : parsed) {
+                TopoRecord r;
+                memset(&r, 0, sizeof(r));
+                r.rid = p.rid;
+                r.sid = sid;
+                r.in_port = p.in_port;
+                r.out_port = p.out_port;
+                r.priority = p.priority;
+                r.text_off = text.size();
+                r.text_len = p.last - p.first;
+                text.append(p.first, p.last);
+                rules.push_back(r);
+                headers.push_back(p.header);
+            }
+        });
+
+    fh.ns = sids.size();
+    fh.nn = nbrs.size();
+    fh.nr = rules.size();
+    fh.nt = text.size();
+    TopoLayout layout(fh);
+
+    string out = Stem(name) + ".btopo";
+
+    ofstream fout("../data/topo/" + out, ios::binary);
+    if(!fout) {
+        throw "directory does not exist. IO::ConvertTopo() exits.";
+    }
+
+    // write each section at its offset, zero padded
+    auto section = [&](size_t offset, const void *p, size_t n) {
+        static const char zeros[8] = {0};
+        fout.write(zeros, offset - fout.tellp());
+        fout.write((const char*)p, n);
+    };
+    section(0, &fh, sizeof(fh));
+    section(layout.sids, sids.data(), sizeof(int32_t) * sids.size());
+    section(layout.nbr_offs, nbr_offs.data(), sizeof(uint32_t) * nbr_offs.size());
+    section(layout.nbrs, nbrs.data(), sizeof(int32_t) * nbrs.size());
+    section(layout.rules, rules.data(), sizeof(TopoRecord) * rules.size());
+    section(layout.headers, headers.data(), sizeof(Header) * headers.size());
+    section(layout.text, text.data(), text.size());
+    if(!fout) {
+        throw "cannot write binary topo file. IO::ConvertTopo() exits.";
+    }
+
+    printf("[ ] write /data/topo/%s\n", out.c_str());
+}
+
+void IO::BuildRuleGraph(SwitchGraph &sg, RuleGraph &rg)
+{
+    vector<int> cands;
+    vector<Header> cand_headers;
+    vector<Prefix> cand_prefixes;
+    RuleTrie trie;
+    unordered_map<int, vector<uint64_t>> masks;  // out header id of r1 -> matched candidates
+    for(auto &it : sg)  {
+        int s1 = it.first;
+        for(auto s2 : sg.at(s1).getNeighbors()) {
+            // r2 on s2 pointed by s1, indexed by in header if there are many
+            cands.clear();
+            cand_headers.clear();
+            cand_prefixes.clear();
+            bool prefixed = true;
+            for(auto r2 : sg.at(s2).getRules()) {
+                const Rule &rule2 = rg.at(r2).getRule();
+                if(rule2.getInPort() != s1) continue;
+                cands.push_back(r2);
+                cand_headers.push_back(rule2.getInHeader());
+                cand_prefixes.push_back(rule2.getInPrefix());
+                prefixed = prefixed && rule2.isPrefix();
+            }
+            if(cands.empty()) continue;
+            masks.clear();
+
+            bool indexed = cands.size() >= TRIE_MIN_RULES;
+            if(indexed) {
+                trie.clear();
+                for(size_t i = 0; i < cands.size(); i++) {
+                    trie.insert(cand_headers[i], i);
+                }
+            }
+
+            // for r1 on s1 pointing to s2
+            for(auto r1 : sg.at(s1).getRules()) {
+                RuleNode &node1 = rg.at(r1);
+                const Rule &rule1 = node1.getRule();
+                if(rule1.getOutPort() != s2) continue;
+                // build a directed edge if two neighboring rules match
+                // rules on s1 sharing an out header (e.g. same prefix, other in_port) match alike
+                auto found = masks.find(rule1.getOutHeaderId());
+                if(found == masks.end()) {
+                    vector<uint64_t> &m = masks[rule1.getOutHeaderId()];
+                    m.resize((cands.size() + 63) / 64);
+                    if(indexed) {
+                        trie.match(rule1.getOutHeader(), m);
+                    }
+                    else if(prefixed && rule1.isPrefix()) {
+                        const Prefix &p1 = rule1.getOutPrefix();
+                        for(size_t i = 0; i < cands.size(); i++) {
+                            m[i / 64] |= (uint64_t)HSA::matchable(p1, cand_prefixes[i]) << (i % 64);
+                        }
+                    }
+                    else {
+                        HSA::matchable(rule1.getOutHeader(), cand_headers.data(), cands.size(), m.data());
+                    }
+                    found = masks.find(rule1.getOutHeaderId());
+                }
+
+                // set bits in candidate order, as a full scan would add them
+                vector<uint64_t> &mask = found->second;
+                size_t count = node1.getNexts().size();
+                for(auto w : mask) {
+                    count += __builtin_popcountll(w);
+                }
+                node1.getNexts().reserve(count);
+                for(size_t w = 0; w < mask.size(); w++) {
+                    for(uint64_t m = mask[w]; m; m &= m - 1) {
+                        node1.addNext(cands[64 * w + __builtin_ctzll(m)]);
+                    }
+                }
+            }
+        }
+    }
+}
+
 void IO::StoreSwitchHeaders(const string &name, Assignments &a, SwitchTestHeaders &sth)
 {
-    ofstream fout("../data/store/" + name);
+    OutStream fout("../data/store/" + name);
     if(!fout) {
         throw "directory does not exist. IO::StoreSwitchHeaders() exits.";
     }
@@ -109,9 +562,9 @@ void IO::StoreSwitchHeaders(const string &name, Assignments &a, SwitchTestHeader
     int masklen = a[SID_OF_MASKLEN].first;
     fout << masklen << endl;
 
-    for(auto it : sth) {
+    for(auto &it : sth) {
         int s = it.first;
-        fout << s << " " << a[s].first << " " << a[s].second << " " << HSA::stringify(sth[s]) << endl;
+        fout << s << " " << a[s].first << " " << a[s].second << " " << HSA::stringify(it.second) << endl;
     }
     
     printf("[ ] write /data/store/%s\n", name.c_str());
@@ -119,13 +572,13 @@ void IO::StoreSwitchHeaders(const string &name, Assignments &a, SwitchTestHeader
 
 void IO::StorePathHeaders(const string &name, PathPacketHeaders &pph, PathTestHeaders &pth)
 {
-    ofstream fout("../data/store/" + name);
+    OutStream fout("../data/store/" + name);
     if(!fout) {
         throw "directory does not exist. IO::StorePathHeaders() exits.";
     }
 
-    for(auto it : pph) {
-        auto p = it.first;
+    for(auto &it : pph) {
+        const vector<int> &p = it.first;
 
         string sp;
         for(auto r : p) {
@@ -133,7 +586,7 @@ void IO::StorePathHeaders(const string &name, PathPacketHeaders &pph, PathTestHe
             sp = "|";
         }
 
-        fout << " " << HSA::stringify(pph[p]) << " " << HSA::stringify(pth[p]) << endl;
+        fout << " " << HSA::stringify(it.second) << " " << HSA::stringify(pth.at(p)) << endl;
     }
     
     printf("[ ] write /data/store/%s\n", name.c_str());
@@ -141,51 +594,78 @@ void IO::StorePathHeaders(const string &name, PathPacketHeaders &pph, PathTestHe
 
 void IO::QuickLoad(const string &name, SwitchGraph &sg, TargetsSet &tss)
 {
-    ifstream fin("../data/tss/" + name);
-    if(!fin) {
+    LineReader reader("../data/tss/" + name);
+    if(!reader.good()) {
         throw "tss file does not exist.";
     }
 
-    // build switch graph
-    int ns;
-    fin >> ns;
-    
-    int sid, neighbor;
-    for(int idx = 0; idx < ns; idx++) {
-        fin >> sid;
-        sg[sid] = SwitchNode(sid, idx);
-        
-        while(fin.get() != '\n') {
-            fin >> neighbor;
-            sg[sid].addNeighbor(neighbor);
+    enum {NUM_SWITCHES, SWITCHES, NUM_PATHS, PATHS, DONE} state = NUM_SWITCHES;
+    int ns = 0, idx = 0, np = 0;
+
+    string chunk;
+    while(state != DONE && reader.next(chunk)) {
+        TextCursor cur = {chunk.data(), chunk.data() + chunk.size()};
+        while(state != DONE && cur.p < cur.end) {
+            if(cur.eol()) {
+                cur.nextLine();
+                continue;
+            }
+
+            switch(state) {
+            case NUM_SWITCHES:
+                ns = cur.integer();
+                state = ns > 0 ? SWITCHES : NUM_PATHS;
+                break;
+
+            case SWITCHES: {
+                // build switch graph
+                int sid = cur.integer();
+                sg[sid] = SwitchNode(sid, idx);
+                while(!cur.eol()) {
+                    sg[sid].addNeighbor(cur.integer());
+                }
+                state = (++idx < ns) ? SWITCHES : NUM_PATHS;
+                break;
+            }
+
+            case NUM_PATHS:
+                np = cur.integer();
+                state = np > 0 ? PATHS : DONE;
+                break;
+
+            case PATHS: {
+                // load targets set (with edge rules excluded and single switch added)
+                vector<int> targets;
+                while(!cur.eol()) {
+                    targets.push_back(cur.integer());
+                }
+                tss.insert(targets);
+                state = (--np > 0) ? PATHS : DONE;
+                break;
+            }
+
+            case DONE:
+                break;
+            }
+            cur.nextLine();
         }
     }
-    
-    // load targets set (with edge rules excluded and single switch added)
-    int np;
-    fin >> np;
-    
-    while(np--) {
-        vector<int> targets;
-        do {
-            fin >> sid;
-            targets.push_back(sid);
-        } while(fin.get() != '\n');
-        
-        tss.insert(targets);
+
+    if(state != DONE) {
+        throw "truncated tss file. IO::QuickLoad() exits.";
     }
 }
 
 void IO::StoreTargetsSet(const string &name, SwitchGraph &sg, TargetsSet &tss)
 {
-    ofstream fout("../data/tss/" + name);
+    OutStream fout("../data/tss/" + name);
     if(!fout) {
         throw "directory does not exist. IO::StoreTargetsSet() exits.";
     }
     
     // switch graph
     fout << sg.size() << endl;
-    for(auto it : sg) {
+    for(auto &it : sg) {
         int sid = it.first;
         fout << sid;
         for(auto neighbor : sg.at(sid).getNeighbors()) {
@@ -196,7 +676,7 @@ void IO::StoreTargetsSet(const string &name, SwitchGraph &sg, TargetsSet &tss)
 
     // targets set
     fout << tss.size() << endl;
-    for(auto ts : tss) {
+    for(auto &ts : tss) {
         string sp;
         for(auto s : ts) {
             fout << sp << s;
@@ -15,15 +15,27 @@ public:
         return io;
     }
     
+    // 'name' ending with .btopo is mapped as a binary topology, otherwise parsed as text (.topo or .topo.gz)
     static void LoadTopo(const string &name, SwitchGraph &sg, RuleGraph &rg);
+    // write the text topology 'name' (.topo) as a binary one (.btopo) next to it
+    static void ConvertTopo(const string &name);
+    static void BuildRuleGraph(SwitchGraph &sg, RuleGraph &rg);
+    // Store* deflate what they write if 'name' ends with .gz
     static void StoreSwitchHeaders(const string &name, Assignments &a, SwitchTestHeaders &sth);
     static void StorePathHeaders(const string &name, PathPacketHeaders &pph, PathTestHeaders &pth);
     
+    // 'name' may be a .tss or a .tss.gz
     static void QuickLoad(const string &name, SwitchGraph &sg, TargetsSet &tss);
     static void StoreTargetsSet(const string &name, SwitchGraph &sg, TargetsSet &tss);
 
+    // 'name' without its extension and a trailing .gz, e.g. "a/b" for "a/b.topo.gz"
+    static string Stem(const string &name);
+
 private:
     IO(){};
+
+    static void LoadTextTopo(const string &name, SwitchGraph &sg, RuleGraph &rg);
+    static void LoadBinaryTopo(const string &name, SwitchGraph &sg, RuleGraph &rg);
 };
 
 #endif
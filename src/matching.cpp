@@ -0,0 +1,22 @@
+#include "matching.hpp"
+
+void Matcher::reset(const DenseRuleGraph &g)
+{
+    int n = g.size();
+    cx.assign(n, -1);   // vertex split
+    cy.assign(n, -1);
+    in_header.resize(n);
+    out_header.resize(n);
+    for(int src = 0; src < n; src++) {
+        in_header[src] = g.getInHeaderId(src);
+        out_header[src] = g.getOutHeaderId(src);
+    }
+
+    feas.assign(g.edges(), -1);
+
+    // epochs go on from the last run, so 'vis' is only cleared when it grows
+    if((int)vis.size() < n) {
+        vis.assign(n, 0);
+        epoch = 0;
+    }
+}
@@ -0,0 +1,288 @@
+#ifndef MATCHING_H
+#define MATCHING_H
+
+#include <atomic>
+#include <deque>
+
+#include "structs.hpp"
+#include "pool.hpp"
+
+/*
+ * Maximum matching engines for the disjoint path cover on a DAG.
+ *
+ * A rule 'v' is split into 'vx' and 'vy', an edge (v1, v2) becomes the edge
+ * (v1x, v2y), and a matched edge links two consecutive rules of a path. A
+ * rule is reached with the header its match leaves it, so an edge is only
+ * taken if the out header of 'v1' matches the in header of 'v2'.
+ *
+ * An engine keeps its scratch between runs: running it again on a graph of
+ * at most the same size allocates nothing, and a run never sees what the
+ * previous one left. Engines share no state, so path covers may run on
+ * several threads at once, each with its own engine.
+ *
+ * Augmenting paths are searched depth first with an explicit stack, as
+ * long as the rule chains they run along, and without recursion.
+ *
+ * Whether the headers of an edge match is cached per edge, tagged with the
+ * in header of its target. It only changes when a rule is rematched: the
+ * edges out of the rule are dropped if its out header changed, and those
+ * into it miss on the tag.
+ */
+class Matcher {
+protected:
+    // size the scratch for 'g' and start from an empty matching
+    void reset(const DenseRuleGraph &g);
+
+    // next epoch to stamp 'vis' with
+    int stamp();
+
+    // (re)match 'v' after 'u', 'v' is then reached with the header of 'u'
+    void rematch(const DenseRuleGraph &g, int u, int v);
+
+    // out header of 'v' after its in header, the cached edges out of 'v' are
+    // dropped if it changed
+    void reheader(const DenseRuleGraph &g, int v);
+
+    // the edge from 'u' at 'next' can be taken with the headers as they are
+    bool feasible(const DenseRuleGraph &g, int u, const int *next);
+
+    // augmenting path from the unmatched 'root' through the edges (u, v)
+    // that 'layered' lets through, in the order a recursive search takes;
+    // once found, 'stack' holds a frame per rule on it from 'root' on
+    template<class Layered>
+    bool augment(const DenseRuleGraph &g, int root, Layered layered);
+
+    // a rule of the search and the cursor to its next to try (the current
+    // arc), which is the one taken while the frames above it are searched
+    struct Frame {
+        int u;
+        const int *next;
+        const int *end;
+    };
+
+    vector<int> cx, cy;         // match
+    vector<int> in_header;      // reachable header
+    vector<int> out_header;     // set-field (reachable header)
+    vector<int> vis;            // stamped with 'epoch'
+    int epoch = 0;
+    vector<Frame> stack;
+    vector<int> feas;           // per edge, in header of the target << 1 | matchable, or -1
+};
+
+// one augmenting path from each rule in turn
+class HungarianMatcher : public Matcher {
+public:
+    void run(const DenseRuleGraph &g, vector<int> &match);
+};
+
+// shortest augmenting paths, phase by phase
+class HopcroftKarpMatcher : public Matcher {
+public:
+    // with 'warm', phases start from a Karp-Sipser matching instead of an empty one
+    explicit HopcroftKarpMatcher(bool warm = false);
+
+    void run(const DenseRuleGraph &g, vector<int> &match);
+
+    // phases of the last run, and pairs its warm start matched
+    int phases() const;
+    int warmed() const;
+
+protected:
+    bool bfs(const DenseRuleGraph &g);
+    bool dfs(const DenseRuleGraph &g, int src);
+    void warmstart(const DenseRuleGraph &g);
+
+    // 'vy' is on a shortest augmenting path through 'ux'
+    bool layered(int u, int v) const;
+
+    int dist;                   // layer of the free 'y' rules of this phase
+    vector<int> d;              // layer of each 'x' rule
+    vector<int> q;
+    int nphases = 0;
+
+    bool warm;
+    int nwarmed = 0;
+    vector<int> deg;            // unmatched neighbors of 'ux' at 'u', of 'vy' at n + 'v'
+    vector<int> out_offs, out_adj;
+    vector<int> in_offs, in_adj;
+    vector<int> order;
+};
+
+/*
+ * Hopcroft-Karp with the searches of a phase on the thread pool.
+ *
+ * A search claims each 'y' rule it passes by stamping it with the phase,
+ * where the serial search marks it visited, so the paths found in a phase
+ * are disjoint. A matched 'x' rule is only reached through its 'y' match
+ * and a root by the one search from it, so a search alone touches the 'x'
+ * rules it goes through. A 'y' rule its headers or layer rule out is given
+ * back, one that led nowhere stays claimed for the phase as in the serial
+ * search. The out header of a rematched rule is read by searches through
+ * its 'x' side, so it is only updated once the phase is over.
+ *
+ * Which paths a phase finds depends on timing, their number does not
+ * shrink a matching: a phase that found none to contention is searched
+ * again on one thread. With a pool of one thread, or from inside a job of
+ * the pool, it is plain Hopcroft-Karp.
+ */
+class ParallelHopcroftKarpMatcher : public HopcroftKarpMatcher {
+public:
+    explicit ParallelHopcroftKarpMatcher(bool warm = false);
+
+    void run(const DenseRuleGraph &g, vector<int> &match);
+
+private:
+    // scratch of a thread
+    struct Local {
+        vector<Frame> frames;
+        vector<int> moved;              // rematched 'y' rules, out headers not updated yet
+    };
+
+    bool claim(int v);
+    void release(int v);
+    bool search(const DenseRuleGraph &g, int root, Local &local);
+    void link(const DenseRuleGraph &g, int u, int v, Local &local);
+    void settle(const DenseRuleGraph &g);
+
+    vector<std::atomic<int>> claims;    // of 'y' rules, stamped with 'phase'
+    int phase = 0;
+    deque<Local> locals;                // of each thread
+    vector<int> roots;
+};
+
+/*
+ * Hopcroft-Karp whose matching is repaired after the graph changed, rather
+ * than matched again.
+ *
+ * A pair of the last run is kept unless one of its rules is gone or the
+ * edge between them is. An augmenting path on the repaired graph then runs
+ * through a rule that lost its pair, is new, or has new nexts, since one
+ * that avoids them all would have augmented the last matching already.
+ * The unmatched rules it can start from reach such a rule along an
+ * alternating path, so they are found by walking those backwards over the
+ * reversed edges, and only they are searched from, one after another as
+ * in Hungarian.
+ *
+ * Rules keep their index from one call to the next, and so do the pairs,
+ * headers and cached edge tests of the rules left alone. A reversed edge
+ * keeps its position in the graph, and is dropped once the walk finds that
+ * the nexts of its source were replaced since, so a repair takes time in
+ * the rules and edges it goes through.
+ */
+class RepairMatcher : public HopcroftKarpMatcher {
+public:
+    // a matching from scratch
+    void run(const DenseRuleGraph &g, vector<int> &match);
+
+    // 'g' is the graph of the last call with the nexts of 'changed' rules
+    // replaced, new rules among them, and the 'removed' rules taken out;
+    // 'match' is that of the last call, the pairs that changed are written
+    // to it, with their 'x' rules and the match each had before in 'moved'
+    void repair(const DenseRuleGraph &g, const vector<int> &changed, const vector<int> &removed, vector<int> &match, vector<pair<int, int>> &moved);
+
+    // pairs the last repair dropped, and paths it augmented
+    int dropped() const;
+    int augmented() const;
+
+private:
+    int ndropped = 0;
+    int naugmented = 0;
+    vector<vector<pair<int, int>>> prevs;   // (rule, edge index) of the edges into each rule, stale ones too
+    vector<char> dirty;                     // sides of a rule an augmenting path must run through
+    vector<int> marked;                     // rules with a 'dirty' flag set by this repair
+    vector<int> rematched;                  // 'x' rules this repair may have matched anew
+    vector<int> roots;
+};
+
+inline int Matcher::stamp()
+{
+    if(epoch == INF) {
+        fill(vis.begin(), vis.end(), 0);
+        epoch = 0;
+    }
+    return ++epoch;
+}
+
+inline void Matcher::rematch(const DenseRuleGraph &g, int u, int v)
+{
+    // Do NOT shrink in_header[v] recursively
+    // instead, reset its in header here before it's (re)matched
+    in_header[v] = HeaderPool::instance().intersection(out_header[u], g.getInHeaderId(v));
+    reheader(g, v);
+
+    cx[u] = v;
+    cy[v] = u;
+}
+
+inline void Matcher::reheader(const DenseRuleGraph &g, int v)
+{
+    int out = g.getAvailableOutHeaderId(v, in_header[v]);
+    if(out != out_header[v]) {
+        out_header[v] = out;
+        DenseRuleGraph::Nexts nexts = g.getNexts(v);
+        fill(feas.begin() + g.getEdgeIndex(nexts.begin()), feas.begin() + g.getEdgeIndex(nexts.end()), -1);
+    }
+}
+
+inline bool Matcher::feasible(const DenseRuleGraph &g, int u, const int *next)
+{
+    int v = *next;
+    int &c = feas[g.getEdgeIndex(next)];
+    if((c >> 1) == in_header[v]) return c & 1;
+
+    bool m = HeaderPool::instance().matchable(out_header[u], in_header[v]);
+    c = in_header[v] << 1 | m;
+    return m;
+}
+
+template<class Layered>
+bool Matcher::augment(const DenseRuleGraph &g, int root, Layered layered)
+{
+    // the frame searched now, those below it wait on 'stack'
+    DenseRuleGraph::Nexts nexts = g.getNexts(root);
+    Frame f{root, nexts.begin(), nexts.end()};
+    stack.clear();
+    while(true) {
+        int down = -1;          // 'x' rule to search next, matched to 'v'
+        for(; f.next != f.end; f.next++) {
+            int v = *f.next;
+            if(vis[v] == epoch) continue;
+            if(!feasible(g, f.u, f.next)) continue;
+
+            // a rule left out by 'layered' here may be fine from another
+            if(!layered(f.u, v)) continue;
+            vis[v] = epoch;
+
+            // 'v' is unmatched: rematch the path, the deepest frame first,
+            // and leave its frames on 'stack'
+            if(cy[v] == -1) {
+                stack.push_back(f);
+                for(size_t k = stack.size(); k-- > 0; ) {
+                    rematch(g, stack[k].u, *stack[k].next);
+                }
+                return true;
+            }
+
+            // 'v' can be unmatched if its match can go elsewhere
+            down = cy[v];
+            break;
+        }
+
+        if(down != -1) {
+            stack.push_back(f);
+            nexts = g.getNexts(down);
+            f = Frame{down, nexts.begin(), nexts.end()};
+        }
+        else if(!stack.empty()) {
+            // nothing after 'f.u', try the next of the frame below
+            f = stack.back();
+            stack.pop_back();
+            f.next++;
+        }
+        else {
+            return false;
+        }
+    }
+}
+
+#endif
@@ -1,61 +1,708 @@
 #include "core.hpp"
 
-void PathCover(RuleGraph &rg, PathSet &ps, bool fast)
+#include <numeric>
+
+// rules from which a component is covered alone, with the thread pool for its
+// phases, smaller ones are batched up to that many rules per task
+#define COMPONENT_BATCH 4096
+
+static int Components(const DenseRuleGraph &g, vector<int> &comp);
+template<class Expand, class Emit>
+static void Cover(const DenseRuleGraph &g, const vector<int> &topoorder, const vector<int> &match, Expand expand, Emit emit);
+
+void PathCover(const RuleGraph &rg, PathSet &ps, string matching, int depth, bool warm)
 {
+    if(matching != "hopcroft-karp" && matching != "parallel" && matching != "hungarian") {
+        throw "undefined matching. PathCover() exits.";
+    }
+
+    // scratch of path cover, released at once when it returns
+    Arena arena;
+
+    // freeze the rule graph, rules are indexed 0..N-1 from here on
+    DenseRuleGraph g(rg);
+    int n = g.size();
+
     // step 1: topological sorting
     vector<int> topoorder;
-    TopoSort(rg, topoorder);
+    TopoSort(g, topoorder);
 
-    if(topoorder.size() < rg.size()) {
+    if((int)topoorder.size() < n) {
         throw "cycle detected. PathCover() exits.";
     }
-    
-    // step 2: non-disjoint path covering
-    // - transitive closure
-    TransPath transpath;
-    TransClosure(rg, transpath);
-    
-    // - disjoint path covering on DAG (solved by maximum matching)
-    unordered_map<int, int> match;
-    fast ? HopcroftKarp(rg, match) : Hungarian(rg, match);
-
-    // - path reconstruction (from 'match' and 'transpath')
-    set<int> vis;
+
+    // weakly connected components, no closure edge or path crosses them, so
+    // each is covered on its own: its rules in index order and topological
+    // order as in 'g', which leaves every step as it would be on all of 'g'
+    vector<int> comp;
+    int ncomps = Components(g, comp);
+    vector<int> comp_offs(ncomps + 1, 0);
+    for(int v = 0; v < n; v++) {
+        comp_offs[comp[v] + 1]++;
+    }
+    for(int c = 0; c < ncomps; c++) {
+        comp_offs[c + 1] += comp_offs[c];
+    }
+    vector<int> members(n), local(n), comp_topo(n);
+    vector<int> pos(comp_offs.begin(), comp_offs.end() - 1);
+    for(int v = 0; v < n; v++) {
+        local[v] = pos[comp[v]] - comp_offs[comp[v]];
+        members[pos[comp[v]]++] = v;
+    }
+    pos.assign(comp_offs.begin(), comp_offs.end() - 1);
+    vector<int> rank(n);
+    for(int i = 0; i < n; i++) {
+        int v = topoorder[i];
+        rank[v] = i;
+        comp_topo[pos[comp[v]]++] = local[v];
+    }
+
+    // the paths of all components, each at the topological rank of its first rule
+    vector<vector<int>> paths(n);
+
+    // step 2: non-disjoint path covering of component 'c', with the scratch of the task
+    auto cover = [&](int c, Arena &arena, HopcroftKarpMatcher &hk, ParallelHopcroftKarpMatcher &phk, HungarianMatcher &hu) {
+        vector<int> vs(members.begin() + comp_offs[c], members.begin() + comp_offs[c + 1]);
+        vector<int> order(comp_topo.begin() + comp_offs[c], comp_topo.begin() + comp_offs[c + 1]);
+        DenseRuleGraph sub;
+        if(ncomps > 1) {
+            sub = DenseRuleGraph(g, vs, local);
+        }
+        const DenseRuleGraph &cg = (ncomps > 1) ? sub : g;
+
+        // - transitive closure
+        DenseRuleGraph closure;
+        TransClosure(cg, order, depth, closure, arena);
+
+        // - disjoint path covering on DAG (solved by maximum matching)
+        vector<int> match;
+        if(matching == "hopcroft-karp") {
+            hk.run(closure, match);
+        }
+        else if(matching == "parallel") {
+            phk.run(closure, match);
+        }
+        else {
+            hu.run(closure, match);
+        }
+
+        // - rules behind the matched closure edges
+        TransPath transpath;
+        TransPaths(cg, order, depth, closure, match, transpath, arena);
+
+        // - path reconstruction (from 'match' and 'transpath'), back to rule ids
+        Cover(cg, order, match, [&](int src, vector<int> &path) {
+            for(auto r : transpath[src]) {
+                path.push_back(cg.getRID(r));
+            }
+        }, [&](int src, vector<int> &&path) {
+            paths[rank[vs[src]]] = move(path);
+        });
+    };
+
+    // large components one after another with the pool for their phases,
+    // the rest in batches on the pool, each phase of a batch on its thread
+    vector<int> large;
+    vector<int> batch_offs(1, 0), batched;
+    int rules = 0;
+    for(int c = 0; c < ncomps; c++) {
+        int size = comp_offs[c + 1] - comp_offs[c];
+        if(size >= COMPONENT_BATCH) {
+            large.push_back(c);
+            continue;
+        }
+        batched.push_back(c);
+        rules += size;
+        if(rules >= COMPONENT_BATCH) {
+            batch_offs.push_back(batched.size());
+            rules = 0;
+        }
+    }
+    if(rules > 0) {
+        batch_offs.push_back(batched.size());
+    }
+
+    ThreadPool::instance().run(batch_offs.size() - 1, [&](size_t b) {
+        Arena arena;
+        HopcroftKarpMatcher hk(warm);
+        ParallelHopcroftKarpMatcher phk(warm);
+        HungarianMatcher hu;
+        for(int k = batch_offs[b]; k < batch_offs[b + 1]; k++) {
+            cover(batched[k], arena, hk, phk, hu);
+        }
+    });
+    HopcroftKarpMatcher hk(warm);
+    ParallelHopcroftKarpMatcher phk(warm);
+    HungarianMatcher hu;
+    for(auto c : large) {
+        cover(c, arena, hk, phk, hu);
+    }
+
+    for(auto &p : paths) {
+        if(!p.empty()) ps.push_back(move(p));
+    }
+
+#ifdef VERBOSE
+    printf("[ ] %d components, %zu covered alone, the rest in %zu batches\n", ncomps, large.size(), batch_offs.size() - 1);
+    printf("[ ] %ld paths as below:\n", ps.size());
+    for(auto &p : ps) {
+        printf("    - path <");
+        for(auto x : p) {
+            printf(" %d", x);
+        }
+    }
+#endif 
+}
+
+IncrementalPathCover::IncrementalPathCover(int depth) :
+    depth(depth)
+{
+
+}
+
+void IncrementalPathCover::build(const RuleGraph &rg, PathSet &ps)
+{
+    Arena arena;
+    built = false;
+    g = DenseRuleGraph(rg);
+    int n = g.size();
+
+    vector<int> topoorder;
+    TopoSort(g, topoorder);
+    if((int)topoorder.size() < n) {
+        throw "cycle detected. build() exits.";
+    }
+    rank.resize(n);
+    for(int i = 0; i < n; i++) {
+        rank[topoorder[i]] = i;
+    }
+    nranks = n;
+
+    vector<int> offs, pv;
+    g.getPrevs(offs, pv);
+    prevs.resize(n);
+    for(int v = 0; v < n; v++) {
+        prevs[v].assign(pv.begin() + offs[v], pv.begin() + offs[v + 1]);
+    }
+
+    vector<int> all(n);
+    iota(all.begin(), all.end(), 0);
+    vector<ArenaNexts> extra(n);
+    TransClosureOf(g, all, depth, extra, arena);
+    closure = DenseRuleGraph(g, extra);
+
+    matcher.run(closure, match);
+    from.assign(n, -1);
+    for(int x = 0; x < n; x++) {
+        if(match[x] != -1) from[match[x]] = x;
+    }
+
+    TransPath transpath(n);
+    TransPathsOf(g, rank, depth, all, match, transpath, arena);
+    subpaths.assign(n, vector<int>());
+    for(int v = 0; v < n; v++) {
+        for(auto r : transpath[v]) {
+            subpaths[v].push_back(g.getRID(r));
+        }
+    }
+
+    unused.clear();
+    seen.assign(n, 0);
+    epoch = 0;
+    hops.assign(n, 0);
+    last.assign(n, -2);
+    head.assign(n, -1);
+    at.assign(n, -1);
+    heads.clear();
+    ps.clear();
+    Cover(g, topoorder, match, [&](int src, vector<int> &path) {
+        path.insert(path.end(), subpaths[src].begin(), subpaths[src].end());
+    }, [&](int src, vector<int> &&path) {
+        for(int v = src; v != -1; v = match[v]) {
+            head[v] = src;
+        }
+        at[src] = ps.size();
+        heads.push_back(src);
+        ps.push_back(move(path));
+    });
+
+    nwalked = n;
+    ndropped = 0;
+    naugmented = 0;
+    built = true;
+}
+
+void IncrementalPathCover::update(const RuleGraph &rg, const RuleGraphDelta &delta, PathSet &ps)
+{
+    if(!built) {
+        throw "no path cover to update. update() exits.";
+    }
+
+    // the rules of the delta, removed ones stamped with 'gone_stamp'
+    int gone_stamp = stamp();
+    vector<int> gone;
+    for(auto rid : delta.removed_rules) {
+        if(!g.hasRID(rid) || rg.count(rid)) {
+            throw "removed rule not in the last graph or still in the rule graph. update() exits.";
+        }
+        int u = g.getIndex(rid);
+        if(seen[u] != gone_stamp) {
+            seen[u] = gone_stamp;
+            gone.push_back(u);
+        }
+    }
+    set<int> added_rules;
+    for(auto rid : delta.added_rules) {
+        if(g.hasRID(rid) || !rg.count(rid)) {
+            throw "added rule already in the last graph or not in the rule graph. update() exits.";
+        }
+        added_rules.insert(rid);
+    }
+    int live = g.size() - unused.size();
+    if(rg.size() != live - gone.size() + added_rules.size()) {
+        throw "rule graph does not match the delta. update() exits.";
+    }
+    auto kept = [&](int rid) {
+        return g.hasRID(rid) && seen[g.getIndex(rid)] != gone_stamp;
+    };
+
+    // one pass over 'rg' for the rules whose nexts changed, comparing each
+    // row with the last one; an edge that changed must be listed in 'delta'
+    // unless it leads to a removed or a new rule, or comes out of a new one
+    set<pair<int, int>> added(delta.added_edges.begin(), delta.added_edges.end());
+    set<pair<int, int>> removed(delta.removed_edges.begin(), delta.removed_edges.end());
+    set<pair<int, int>> listed;
+    vector<pair<int, const vector<int>*>> rows;
+    vector<int> before, after, diff;
+    for(auto &it : rg) {
+        int rid = it.first;
+        const vector<int> &nexts = it.second.getNexts();
+        if(!g.hasRID(rid)) {
+            if(!added_rules.count(rid)) {
+                throw "rule in the rule graph but neither in the last graph nor added. update() exits.";
+            }
+            for(auto w : nexts) {
+                if(!kept(w) && !added_rules.count(w)) {
+                    throw "edge to a rule not in the rule graph. update() exits.";
+                }
+            }
+            rows.push_back(make_pair(rid, &nexts));
+            continue;
+        }
+
+        int u = g.getIndex(rid);
+        DenseRuleGraph::Nexts row = g.getNexts(u);
+        bool same = row.size() == nexts.size();
+        for(size_t i = 0; same && i < nexts.size(); i++) {
+            int w = row.begin()[i];
+            same = seen[w] != gone_stamp && g.getRID(w) == nexts[i];
+        }
+        if(same) continue;
+        rows.push_back(make_pair(rid, &nexts));
+
+        before.clear();
+        for(auto w : row) {
+            if(seen[w] != gone_stamp) before.push_back(g.getRID(w));
+        }
+        after.assign(nexts.begin(), nexts.end());
+        sort(before.begin(), before.end());
+        sort(after.begin(), after.end());
+        diff.clear();
+        set_difference(after.begin(), after.end(), before.begin(), before.end(), back_inserter(diff));
+        for(auto w : diff) {
+            if(!kept(w)) {
+                if(!added_rules.count(w)) {
+                    throw "edge to a rule not in the rule graph. update() exits.";
+                }
+                continue;
+            }
+            if(!added.count(make_pair(rid, w))) {
+                throw "edge added to the rule graph but not to the delta. update() exits.";
+            }
+            listed.insert(make_pair(rid, w));
+        }
+        diff.clear();
+        set_difference(before.begin(), before.end(), after.begin(), after.end(), back_inserter(diff));
+        for(auto w : diff) {
+            if(!removed.count(make_pair(rid, w))) {
+                throw "edge removed from the rule graph but not from the delta. update() exits.";
+            }
+            listed.insert(make_pair(rid, w));
+        }
+    }
+    if(listed.size() != added.size() + removed.size()) {
+        throw "edge in the delta but not changed in the rule graph. update() exits.";
+    }
+
+    // once half the graph is stale edges or unused rules, start over
+    if(2 * g.stale() > g.edges() || 2 * closure.stale() > closure.edges() || (int)unused.size() > live) {
+        build(rg, ps);
+        return;
+    }
+
+    // from here on a failed update leaves nothing to update
+    built = false;
+    Arena arena;
+
+    // removed rules lose their edges, their index is reused by a later update
+    for(auto u : gone) {
+        for(auto w : g.getNexts(u)) {
+            if(seen[w] != gone_stamp) unlink(u, w);
+        }
+        prevs[u].clear();
+        g.removeRule(u);
+        closure.setNexts(u, vector<int>());
+        subpaths[u].clear();
+    }
+
+    // new rules, last in topological order for now
+    for(auto rid : added_rules) {
+        int v = g.size();
+        if(!unused.empty()) {
+            v = unused.back();
+            unused.pop_back();
+        }
+        g.setRule(v, rid, rg.at(rid).getRule());
+        if(v == (int)rank.size()) {
+            prevs.emplace_back();
+            rank.push_back(0);
+            match.push_back(-1);
+            from.push_back(-1);
+            subpaths.emplace_back();
+            seen.push_back(0);
+            hops.push_back(0);
+            last.push_back(-2);
+            head.push_back(-1);
+            at.push_back(-1);
+        }
+        rank[v] = nranks++;
+    }
+
+    // the changed rows: edges out of them taken out first, then the new ones
+    // put in row by row, each moving rules in topological order as it needs
+    vector<int> touched;
+    vector<vector<int>> news(rows.size()), gains(rows.size());
+    for(size_t i = 0; i < rows.size(); i++) {
+        int u = g.getIndex(rows[i].first);
+        touched.push_back(u);
+        for(auto w : *rows[i].second) {
+            news[i].push_back(g.getIndex(w));
+        }
+
+        before.clear();
+        for(auto w : g.getNexts(u)) {
+            if(seen[w] != gone_stamp) before.push_back(w);
+        }
+        after = news[i];
+        sort(before.begin(), before.end());
+        sort(after.begin(), after.end());
+        diff.clear();
+        set_difference(before.begin(), before.end(), after.begin(), after.end(), back_inserter(diff));
+        for(auto w : diff) {
+            unlink(u, w);
+        }
+        set_difference(after.begin(), after.end(), before.begin(), before.end(), back_inserter(gains[i]));
+        if(gains[i].empty()) {
+            g.setNexts(u, news[i]);
+        }
+        else if(!diff.empty() || before.size() < g.getNexts(u).size()) {
+            diff.clear();
+            set_intersection(before.begin(), before.end(), after.begin(), after.end(), back_inserter(diff));
+            g.setNexts(u, diff);
+        }
+    }
+    for(size_t i = 0; i < rows.size(); i++) {
+        if(gains[i].empty()) continue;
+        int u = touched[i];
+        g.setNexts(u, news[i]);
+        for(auto w : gains[i]) {
+            prevs[w].push_back(u);
+            reorder(u, w);
+        }
+    }
+
+    // rules whose closure edges may have changed: those that reach a touched
+    // one within 'depth' - 1 hops
+    int walk_stamp = stamp();
+    vector<int> walk;
+    for(auto v : touched) {
+        if(seen[v] != walk_stamp) {
+            seen[v] = walk_stamp;
+            hops[v] = 0;
+            walk.push_back(v);
+        }
+    }
+    for(size_t k = 0; k < walk.size(); k++) {
+        int v = walk[k];
+        if(depth && hops[v] == depth - 1) continue;
+        for(auto u : prevs[v]) {
+            if(seen[u] != walk_stamp) {
+                seen[u] = walk_stamp;
+                hops[u] = hops[v] + 1;
+                walk.push_back(u);
+            }
+        }
+    }
+
+    // walk those again, and repair the matching around them
+    vector<ArenaNexts> extra(walk.size());
+    TransClosureOf(g, walk, depth, extra, arena);
+    for(size_t k = 0; k < walk.size(); k++) {
+        DenseRuleGraph::Nexts base = g.getNexts(walk[k]);
+        after.assign(base.begin(), base.end());
+        after.insert(after.end(), extra[k].begin(), extra[k].end());
+        closure.setNexts(walk[k], after);
+    }
+
+    vector<pair<int, int>> moved;
+    matcher.repair(closure, walk, gone, match, moved);
+    for(auto &m : moved) {
+        last[m.first] = m.second;
+        if(m.second != -1 && from[m.second] == m.first) from[m.second] = -1;
+    }
+    for(auto &m : moved) {
+        if(match[m.first] != -1) from[match[m.first]] = m.first;
+    }
+
+    // trace the rules behind a matched closure edge again if the pair is new
+    // or its source was walked again
+    vector<int> traced;
+    for(auto v : walk) {
+        if(match[v] != -1) traced.push_back(v);
+        else subpaths[v].clear();
+    }
+    for(auto &m : moved) {
+        int x = m.first;
+        if(seen[x] == walk_stamp) continue;
+        if(match[x] != -1) traced.push_back(x);
+        else subpaths[x].clear();
+    }
+    TransPath transpath(traced.size());
+    TransPathsOf(g, rank, depth, traced, match, transpath, arena);
+    for(size_t k = 0; k < traced.size(); k++) {
+        vector<int> &sub = subpaths[traced[k]];
+        sub.clear();
+        for(auto r : transpath[k]) {
+            sub.push_back(g.getRID(r));
+        }
+    }
+
+    // paths through a rule matched anew, traced again, removed or new are
+    // taken out, and those of their rules put back as they are now
+    int drop_stamp = stamp();
+    vector<int> olds;
+    auto drop = [&](int v) {
+        int h = head[v];
+        if(h != -1 && seen[h] != drop_stamp) {
+            seen[h] = drop_stamp;
+            olds.push_back(h);
+        }
+    };
+    for(auto &m : moved) {
+        drop(m.first);
+        if(match[m.first] != -1) drop(match[m.first]);
+    }
+    for(auto v : traced) {
+        drop(v);
+    }
+    for(auto v : gone) {
+        drop(v);
+    }
+
+    vector<int> members;
+    for(auto h : olds) {
+        for(int v = h; v != -1; v = (last[v] != -2) ? last[v] : match[v]) {
+            head[v] = -1;
+            if(g.getRID(v) != -1) members.push_back(v);
+        }
+
+        size_t k = at[h];
+        if(k + 1 < ps.size()) {
+            ps[k] = move(ps.back());
+            heads[k] = heads.back();
+            at[heads[k]] = k;
+        }
+        ps.pop_back();
+        heads.pop_back();
+        at[h] = -1;
+    }
+    for(auto &m : moved) {
+        last[m.first] = -2;
+    }
+    for(auto rid : added_rules) {
+        members.push_back(g.getIndex(rid));
+    }
+
+    // first rules of the new paths, up along 'from' to one with no match into it
+    int first_stamp = stamp();
+    vector<int> firsts;
+    for(auto v : members) {
+        while(seen[v] != first_stamp) {
+            seen[v] = first_stamp;
+            if(from[v] == -1) {
+                firsts.push_back(v);
+                break;
+            }
+            v = from[v];
+        }
+    }
+    for(auto src : firsts) {
+        vector<int> path;
+        path.push_back(g.getRID(src));
+        for(int v = src; v != -1; v = match[v]) {
+            head[v] = src;
+            path.insert(path.end(), subpaths[v].begin(), subpaths[v].end());
+        }
+        at[src] = ps.size();
+        heads.push_back(src);
+        ps.push_back(move(path));
+    }
+
+    unused.insert(unused.end(), gone.begin(), gone.end());
+    nwalked = walk.size();
+    ndropped = matcher.dropped();
+    naugmented = matcher.augmented();
+    built = true;
+}
+
+int IncrementalPathCover::walked() const
+{
+    return nwalked;
+}
+
+int IncrementalPathCover::dropped() const
+{
+    return ndropped;
+}
+
+int IncrementalPathCover::augmented() const
+{
+    return naugmented;
+}
+
+// next epoch to stamp 'seen' with
+int IncrementalPathCover::stamp()
+{
+    if(epoch == INF) {
+        fill(seen.begin(), seen.end(), 0);
+        epoch = 0;
+    }
+    return ++epoch;
+}
+
+// 'u' no longer has 'w' in its nexts
+void IncrementalPathCover::unlink(int u, int w)
+{
+    vector<int> &pv = prevs[w];
+    auto it = find(pv.begin(), pv.end(), u);
+    *it = pv.back();
+    pv.pop_back();
+}
+
+// Pearce-Kelly: after the edge (x, y) came in, the rules 'y' reaches that
+// rank below 'x' take the ranks after those that reach 'x' and rank above 'y'
+void IncrementalPathCover::reorder(int x, int y)
+{
+    int lower = rank[y], upper = rank[x];
+    if(lower > upper) return;
+
+    int mark = stamp();
+    auto search = [&](int src, vector<int> &found, bool forward) {
+        found.clear();
+        found.push_back(src);
+        seen[src] = mark;
+        for(size_t k = 0; k < found.size(); k++) {
+            int u = found[k];
+            auto visit = [&](int w) {
+                if(forward && w == x) {
+                    throw "cycle detected. update() exits.";
+                }
+                if(seen[w] != mark && (forward ? rank[w] < upper : rank[w] > lower)) {
+                    seen[w] = mark;
+                    found.push_back(w);
+                }
+            };
+            if(forward) {
+                for(auto w : g.getNexts(u)) visit(w);
+            }
+            else {
+                for(auto w : prevs[u]) visit(w);
+            }
+        }
+    };
+    vector<int> down, up;
+    search(y, down, true);
+    search(x, up, false);
+
+    auto by_rank = [&](int a, int b) { return rank[a] < rank[b]; };
+    sort(down.begin(), down.end(), by_rank);
+    sort(up.begin(), up.end(), by_rank);
+    vector<int> ranks;
+    for(auto v : up) ranks.push_back(rank[v]);
+    for(auto v : down) ranks.push_back(rank[v]);
+    sort(ranks.begin(), ranks.end());
+    size_t k = 0;
+    for(auto v : up) rank[v] = ranks[k++];
+    for(auto v : down) rank[v] = ranks[k++];
+}
+
+// union-find over the edges, components are numbered by their lowest rule
+int Components(const DenseRuleGraph &g, vector<int> &comp)
+{
+    int n = g.size();
+    vector<int> parent(n);
+    iota(parent.begin(), parent.end(), 0);
+    auto find = [&](int v) {
+        while(parent[v] != v) {
+            v = parent[v] = parent[parent[v]];
+        }
+        return v;
+    };
+    for(int u = 0; u < n; u++) {
+        for(auto v : g.getNexts(u)) {
+            int a = find(u), b = find(v);
+            if(a != b) parent[max(a, b)] = min(a, b);
+        }
+    }
+
+    // a root is the lowest rule of its component, so it is numbered first
+    int ncomps = 0;
+    comp.assign(n, -1);
+    for(int v = 0; v < n; v++) {
+        int r = find(v);
+        if(comp[r] == -1) comp[r] = ncomps++;
+        comp[v] = comp[r];
+    }
+    return ncomps;
+}
+
+// paths along 'match', each from the first rule in topological order on no
+// path yet, 'expand' appends the rules behind the matched closure edge out of
+// 'src', and 'emit' takes a path from its first rule
+template<class Expand, class Emit>
+void Cover(const DenseRuleGraph &g, const vector<int> &topoorder, const vector<int> &match, Expand expand, Emit emit)
+{
+    vector<bool> vis(g.size(), false);
     for(auto src : topoorder) {
-        if(vis.find(src) != vis.end()) continue;
-        vis.insert(src);
+        if(vis[src]) continue;
+        vis[src] = true;
 
+        int first = src;
         vector<int> path;
-        path.push_back(src);
+        path.push_back(g.getRID(src));
         
         int v = match[src];
         while(v != -1) {
-            vis.insert(v);
+            vis[v] = true;
             
             // expand the transitive path
-            vector<int> subpath;
-            int end = v;
-            while(end != src) {
-                subpath.push_back(end);
-                end = transpath[src][end];  // trace back in 'transpath'
-            }
-            path.insert(path.end(), subpath.rbegin(), subpath.rend());
+            expand(src, path);
             
             // trace down in 'match'
             src = v;
             v = match[src];
         }
 
-        ps.push_back(path);
+        emit(first, move(path));
     }
-
-#ifdef VERBOSE
-    printf("[ ] %ld paths as below:\n", ps.size());
-    for(auto p : ps) {
-        printf("    - path <");
-        for(auto x : p) {
-            printf(" %d", x);
-        }
-    }
-#endif 
 }
@@ -0,0 +1,149 @@
+#include "pool.hpp"
+#include "hsa.hpp"
+
+HeaderPool::HeaderPool() : next(0), hit_ct(0), miss_ct(0)
+{
+    for(auto &c : chunks) {
+        c.store(nullptr);
+    }
+    for(auto &e : match_memo) {
+        e.store(0);
+    }
+}
+
+size_t HeaderPool::HeaderHash::operator()(const Header &h) const
+{
+    uint64_t x = 0;
+    for(size_t w = 0; w < h.words(); w++) {
+        x = (x ^ h.lo[w]) * 0x9e3779b97f4a7c15ULL;
+        x = (x ^ h.hi[w]) * 0x9e3779b97f4a7c15ULL;
+    }
+
+    return x ^ (x >> 29);
+}
+
+static inline uint64_t Mix(uint64_t x)
+{
+    x = (x ^ (x >> 31)) * 0x7fb5d329728ea185ULL;
+    return x ^ (x >> 27);
+}
+
+int HeaderPool::intern(const Header &h)
+{
+    Shard &sh = shards[HeaderHash()(h) % SHARDS];
+    lock_guard<mutex> lock(sh.mtx);
+
+    auto it = sh.ids.find(h);
+    if(it != sh.ids.end()) {
+        return it->second;
+    }
+
+    int hid = next++;
+    if((hid >> CHUNK_BITS) >= MAX_CHUNKS) {
+        throw "too many distinct headers. HeaderPool::intern() exits.";
+    }
+
+    Entry *chunk = chunks[hid >> CHUNK_BITS].load(memory_order_acquire);
+    if(!chunk) {
+        lock_guard<mutex> clock(chunk_mtx);
+        chunk = chunks[hid >> CHUNK_BITS].load(memory_order_acquire);
+        if(!chunk) {
+            chunk = new Entry[1 << CHUNK_BITS];
+            chunks[hid >> CHUNK_BITS].store(chunk, memory_order_release);
+        }
+    }
+    Entry &e = chunk[hid & ((1 << CHUNK_BITS) - 1)];
+    e.header = h;
+    e.prefixed = HSA::toPrefix(h, e.prefix);
+
+    sh.ids[h] = hid;
+    return hid;
+}
+
+const HeaderPool::Entry& HeaderPool::entry(int hid)
+{
+    return chunks[hid >> CHUNK_BITS].load(memory_order_acquire)[hid & ((1 << CHUNK_BITS) - 1)];
+}
+
+const Header& HeaderPool::get(int hid)
+{
+    return entry(hid).header;
+}
+
+bool HeaderPool::isPrefix(int hid)
+{
+    return entry(hid).prefixed;
+}
+
+const Prefix& HeaderPool::getPrefix(int hid)
+{
+    return entry(hid).prefix;
+}
+
+int HeaderPool::size()
+{
+    return next;
+}
+
+bool HeaderPool::matchable(int a, int b)
+{
+    // matchability is symmetric
+    if(a > b) swap(a, b);
+
+    uint64_t key = (uint64_t)a << 33 | (uint64_t)b << 2 | 2;
+    std::atomic<uint64_t> &slot = match_memo[Mix(key) & ((1 << MEMO_BITS) - 1)];
+
+    uint64_t e = slot.load(memory_order_relaxed);
+    if((e & ~(uint64_t)1) == key) {
+        hit_ct.fetch_add(1, memory_order_relaxed);
+        return e & 1;
+    }
+
+    miss_ct.fetch_add(1, memory_order_relaxed);
+    bool m = HSA::matchable(get(a), get(b));
+    slot.store(key | m, memory_order_relaxed);
+
+    return m;
+}
+
+int HeaderPool::intersection(int a, int b)
+{
+    if(a == b) return a;
+    if(a > b) swap(a, b);
+
+    uint64_t key = (uint64_t)a << 32 | (uint64_t)b;
+    MemoShard &sh = memo_shards[Mix(key) % SHARDS];
+    {
+        lock_guard<mutex> lock(sh.mtx);
+        auto it = sh.inter.find(key);
+        if(it != sh.inter.end()) {
+            hit_ct.fetch_add(1, memory_order_relaxed);
+            return it->second;
+        }
+    }
+
+    miss_ct.fetch_add(1, memory_order_relaxed);
+    int c = intern(HSA::intersection(get(a), get(b)));
+
+    lock_guard<mutex> lock(sh.mtx);
+    sh.inter[key] = c;
+
+    return c;
+}
+
+unsigned long HeaderPool::hits()
+{
+    return hit_ct;
+}
+
+unsigned long HeaderPool::misses()
+{
+    return miss_ct;
+}
+
+void HeaderPool::report()
+{
+    unsigned long total = hits() + misses();
+    printf("[ ] header pool: %d distinct headers, memo %lu hits / %lu misses (%.1f%% hit rate)\n",
+           size(), hits(), misses(), total ? 100.0 * hits() / total : 0.0);
+}
@@ -0,0 +1,87 @@
+#ifndef POOL_H
+#define POOL_H
+
+#include <atomic>
+#include <mutex>
+
+#include "structs.hpp"
+
+/*
+ * Hash-consed header pool.
+ *
+ * Each distinct header is stored once and rules refer to it by a small id,
+ * so the thousands of rules sharing a destination prefix share one header.
+ * A header that is a pure IPv4 prefix also keeps its compact Prefix form.
+ * Results of HSA::matchable and HSA::intersection are memoized by id pair.
+ * All members can be called from several threads at once.
+ */
+class HeaderPool {
+public:
+    HeaderPool(const HeaderPool&)=delete;
+    HeaderPool& operator=(const HeaderPool&)=delete;
+    static HeaderPool& instance() {
+        static HeaderPool pool;
+        return pool;
+    }
+
+    int intern(const Header &h);
+    const Header& get(int hid);
+    int size();
+
+    // compact form of a header, valid only if it is a pure prefix
+    bool isPrefix(int hid);
+    const Prefix& getPrefix(int hid);
+
+    // memoized HSA::matchable and HSA::intersection on header ids
+    bool matchable(int a, int b);
+    int intersection(int a, int b);
+
+    // memo statistics
+    unsigned long hits();
+    unsigned long misses();
+    void report();
+
+private:
+    HeaderPool();
+
+    struct HeaderHash {
+        size_t operator()(const Header &h) const;
+    };
+
+    static const int SHARDS = 64;
+    static const int CHUNK_BITS = 16;
+    static const int MAX_CHUNKS = 1 << 15;
+    static const int MEMO_BITS = 16;
+
+    struct Entry {
+        Header header;
+        Prefix prefix;
+        bool prefixed;
+    };
+    const Entry& entry(int hid);
+
+    // id -> header, in chunks that never move once allocated
+    std::atomic<Entry*> chunks[MAX_CHUNKS];
+    std::mutex chunk_mtx;
+    std::atomic<int> next;
+
+    // header -> id
+    struct Shard {
+        std::mutex mtx;
+        unordered_map<Header, int, HeaderHash> ids;
+    } shards[SHARDS];
+
+    // (a, b) -> matchable, direct mapped, packed as a:31 | b:31 | valid:1 | result:1
+    std::atomic<uint64_t> match_memo[1 << MEMO_BITS];
+
+    // (a, b) -> id of the intersection
+    struct MemoShard {
+        std::mutex mtx;
+        unordered_map<uint64_t, int> inter;
+    } memo_shards[SHARDS];
+
+    std::atomic<unsigned long> hit_ct;
+    std::atomic<unsigned long> miss_ct;
+};
+
+#endif
@@ -8,26 +8,48 @@
 
 void usage()
 {
-    printf("[-] Usage: ./setup -f <topofile> -m <mode> -p <threshold>\n"
-           "[ ] <topofile>: filename under /data/topo/\n"
+    printf("[-] Usage: ./setup -f <topofile> -m <mode> -p <threshold> [-d <depth>] [-a <matching>] [-w] [-j <threads>] [-z] [-H]\n"
+           "[-]        ./setup -f <topofile> -c\n"
+           "[ ] <topofile>: filename under /data/topo/, text (.topo, .topo.gz) or binary (.btopo)\n"
+           "[ ] -c: convert a .topo into a .btopo and exit\n"
            "[ ] <mode>: simple|greedy|compact\n"
-           "[ ] <threshold>: non-negative path length threshold (0 as infinity)\n");
+           "[ ] <threshold>: non-negative path length threshold (0 as infinity)\n"
+           "[ ] <depth>: hops a transitive closure edge may span (0 as infinity, by default), or p for the threshold;\n"
+           "[ ]          a bound speeds up path cover but may need more header bits\n"
+           "[ ] <matching>: hopcroft-karp (by default)|parallel|hungarian\n"
+           "[ ] -w: start hopcroft-karp and parallel from a Karp-Sipser matching\n"
+           "[ ] <threads>: number of threads (1 by default)\n"
+           "[ ] -z: write gzipped .store.gz files\n"
+           "[ ] -H: back the scratch arenas with huge pages\n");
 }
 
 int main(int argc, char** argv)
 {
     string name;
     string mode;
+    string matching = "hopcroft-karp";
     unsigned plt = INF;     // path length threshold
+    int depth = 0;          // closure depth, -1 for the threshold
     int verbose = 0;
+    int convert = 0;
+    int warm = 0;
+    int threads = 1;
+    string gz;
 
     int opt;
-    while((opt = getopt(argc, argv, "f:m:p:v")) != -1) {
+    while((opt = getopt(argc, argv, "f:m:p:d:a:wvcj:zH")) != -1) {
        switch(opt) {
            case 'f': name = optarg; break;
            case 'm': mode = optarg; break;
            case 'p': plt = atoi(optarg); break;
+           case 'd': depth = (string(optarg) == "p") ? -1 : atoi(optarg); break;
+           case 'a': matching = optarg; break;
+           case 'w': warm = 1; break;
            case 'v': verbose = 1; break;
+           case 'c': convert = 1; break;
+           case 'j': threads = atoi(optarg); break;
+           case 'z': gz = ".gz"; break;
+           case 'H': Arena::hugepages(true); break;
            default: usage(); return 0;
        }
     }
@@ -35,8 +57,15 @@ int main(int argc, char** argv)
     if(name.empty()) { usage(); return 0; }
     if(mode.empty()) { mode = "compact"; }
     if(plt <= 0) { plt = INF; }
+    if(depth < 0) { depth = (plt == INF) ? 0 : plt; }
+    if(threads > 1) { ThreadPool::instance().resize(threads); }
     
     try {
+
+    if(convert) {
+        IO::instance().ConvertTopo(name);
+        return 0;
+    }
     
     auto st = chrono::high_resolution_clock::now();  // start clock
     
@@ -49,12 +78,18 @@ int main(int argc, char** argv)
     /* path cover */
     VSTAT(printf("[ ] solve path cover...\n");)
     PathSet ps;
-    PathCover(rg, ps, true);
+    PathCover(rg, ps, matching, depth, warm);
+    VSTAT(HeaderPool::instance().report();)
 
     /* split paths */
     VSTAT(printf("[ ] split paths...\n");)
     PathSet split_ps;
-    for(auto p : ps) {
+    for(auto &p : ps) {
+        if(p.size() <= plt) {
+            // short enough to keep as a whole
+            split_ps.push_back(move(p));
+            continue;
+        }
         for(auto iter = p.begin(); iter < p.end(); iter += plt) {
             split_ps.push_back(vector<int>(iter, iter + plt >= p.end() ? p.end() : iter + plt));
         }
@@ -77,13 +112,14 @@ int main(int argc, char** argv)
     PathHeadersCalculation(sg, rg, a, split_ps, pph, pth);
 
     /* persist headers */
-    name.replace(name.end()-5, name.end(), "");     // remove ".topo"
-    IO::instance().StoreSwitchHeaders(name + ".switch.store", a, sth);
-    IO::instance().StorePathHeaders(name + ".path.store", pph, pth);
+    string topo = name;
+    name = IO::Stem(name);     // remove ".topo", ".topo.gz" or ".btopo"
+    IO::instance().StoreSwitchHeaders(name + ".switch.store" + gz, a, sth);
+    IO::instance().StorePathHeaders(name + ".path.store" + gz, pph, pth);
 
     chrono::duration<double, milli> drt = chrono::high_resolution_clock::now() - st;
     
-    printf("\033[32m[!] [%s] [%s] [p=%d] [b=%d] [t=%f]\033[0m\n", (name+".topo").c_str(), mode.c_str(), plt, a[SID_OF_MASKLEN].first, float(drt.count()) / 1000.0); 
+    printf("\033[32m[!] [%s] [%s] [p=%d] [b=%d] [t=%f]\033[0m\n", topo.c_str(), mode.c_str(), plt, a[SID_OF_MASKLEN].first, float(drt.count()) / 1000.0); 
     }
     catch(const char* err) {
         printf("\033[31m[x] error: %s\033[0m\n", err);
@@ -0,0 +1,172 @@
+#include "stream.hpp"
+
+#include <cstring>
+
+static bool EndsWithGz(const string &path)
+{
+    return path.size() >= 3 && path.compare(path.size() - 3, 3, ".gz") == 0;
+}
+
+LineReader::LineReader(const string &path) : eof(false), stopping(false), error(nullptr)
+{
+    // gzread passes files that are not gzipped through as they are
+    gz = gzopen(path.c_str(), "rb");
+    if(gz) {
+        gzbuffer(gz, 1 << 17);
+        producer = thread(&LineReader::produce, this);
+    }
+}
+
+LineReader::~LineReader()
+{
+    {
+        lock_guard<mutex> lock(mtx);
+        stopping = true;
+    }
+    cv.notify_all();
+    if(producer.joinable()) {
+        producer.join();
+    }
+    if(gz) {
+        gzclose(gz);
+    }
+}
+
+bool LineReader::good()
+{
+    return gz != nullptr;
+}
+
+void LineReader::produce()
+{
+    string carry;   // trailing partial line of the last read
+    while(true) {
+        string chunk;
+        chunk.swap(carry);
+        size_t off = chunk.size();
+        chunk.resize(off + CHUNK);
+        int n = gzread(gz, &chunk[off], CHUNK);
+        if(n < 0) {
+            lock_guard<mutex> lock(mtx);
+            error = "cannot read file. LineReader::next() exits.";
+            eof = true;
+            cv.notify_all();
+            break;
+        }
+        chunk.resize(off + n);
+
+        bool last = (n == 0);
+        if(!last) {
+            size_t nl = chunk.rfind('\n');
+            if(nl == string::npos) {
+                carry.swap(chunk);
+                continue;
+            }
+            carry.assign(chunk, nl + 1, string::npos);
+            chunk.resize(nl + 1);
+        }
+
+        unique_lock<mutex> lock(mtx);
+        cv.wait(lock, [&]{ return stopping || ready.size() < AHEAD; });
+        if(stopping) break;
+        if(!chunk.empty()) {
+            ready.push_back(move(chunk));
+        }
+        if(last) {
+            eof = true;
+            cv.notify_all();
+            break;
+        }
+        cv.notify_all();
+    }
+}
+
+bool LineReader::next(string &chunk)
+{
+    unique_lock<mutex> lock(mtx);
+    cv.wait(lock, [&]{ return eof || !ready.empty(); });
+    if(error) {
+        throw error;
+    }
+    if(ready.empty()) {
+        return false;
+    }
+
+    chunk = move(ready.front());
+    ready.pop_front();
+    cv.notify_all();
+    return true;
+}
+
+OutStream::OutStream(const string &path) : ostream(&gzbuf)
+{
+    if(!gzbuf.open(path, EndsWithGz(path))) {
+        setstate(ios::failbit);
+    }
+}
+
+OutStream::~OutStream()
+{
+    gzbuf.close();
+}
+
+OutStream::GzBuf::GzBuf() : gz(nullptr)
+{
+    setp(buf, buf + sizeof(buf));
+}
+
+bool OutStream::GzBuf::open(const string &path, bool compress)
+{
+    // "T" writes plain bytes without a gzip wrapper
+    gz = gzopen(path.c_str(), compress ? "wb6" : "wbT");
+    return gz != nullptr;
+}
+
+bool OutStream::GzBuf::close()
+{
+    if(!gz) return true;
+    bool ok = flush();
+    ok = (gzclose(gz) == Z_OK) && ok;
+    gz = nullptr;
+    return ok;
+}
+
+bool OutStream::GzBuf::flush()
+{
+    int n = pptr() - pbase();
+    if(n > 0 && gzwrite(gz, pbase(), n) != n) {
+        return false;
+    }
+    setp(buf, buf + sizeof(buf));
+    return true;
+}
+
+int OutStream::GzBuf::overflow(int ch)
+{
+    if(!gz || !flush()) {
+        return traits_type::eof();
+    }
+    if(ch != traits_type::eof()) {
+        *pptr() = ch;
+        pbump(1);
+    }
+    return traits_type::not_eof(ch);
+}
+
+streamsize OutStream::GzBuf::xsputn(const char *s, streamsize n)
+{
+    if(n < epptr() - pptr()) {
+        memcpy(pptr(), s, n);
+        pbump(n);
+        return n;
+    }
+    if(!gz || !flush() || gzwrite(gz, s, n) != n) {
+        return 0;
+    }
+    return n;
+}
+
+int OutStream::GzBuf::sync()
+{
+    return (gz && flush()) ? 0 : -1;
+}
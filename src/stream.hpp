@@ -0,0 +1,76 @@
+#ifndef STREAM_H
+#define STREAM_H
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <ostream>
+#include <thread>
+#include <zlib.h>
+
+#include "structs.hpp"
+
+/*
+ * Reads a file, gzipped or not, in chunks of whole lines.
+ *
+ * A background thread reads (and inflates) up to AHEAD chunks ahead of the
+ * consumer, so decompression overlaps whatever the consumer does with the
+ * previous chunk. Every chunk but the last ends with '\n'.
+ */
+class LineReader {
+public:
+    explicit LineReader(const string &path);
+    ~LineReader();
+    LineReader(const LineReader&)=delete;
+    LineReader& operator=(const LineReader&)=delete;
+
+    bool good();
+
+    // move the next chunk into 'chunk', false at the end of the file
+    bool next(string &chunk);
+
+private:
+    void produce();
+
+    static const size_t CHUNK = 1 << 20;
+    static const size_t AHEAD = 2;
+
+    gzFile gz;
+    thread producer;
+    mutex mtx;
+    condition_variable cv;
+    deque<string> ready;
+    bool eof;
+    bool stopping;
+    const char *error;
+};
+
+/*
+ * Output file stream, deflated if the path ends with ".gz".
+ */
+class OutStream : public ostream {
+public:
+    explicit OutStream(const string &path);
+    ~OutStream();
+
+private:
+    class GzBuf : public streambuf {
+    public:
+        GzBuf();
+        bool open(const string &path, bool compress);
+        bool close();
+
+    protected:
+        int overflow(int ch);
+        streamsize xsputn(const char *s, streamsize n);
+        int sync();
+
+    private:
+        bool flush();
+
+        gzFile gz;
+        char buf[1 << 16];
+    } gzbuf;
+};
+
+#endif
@@ -1,45 +1,89 @@
 #include "structs.hpp"
 #include "hsa.hpp"
+#include "pool.hpp"
 
 Rule::Rule(int rid, int sid, string prefix, int in_port, int out_port, int priority) :
-    rid(rid), sid(sid), prefix(prefix), in_port(in_port), out_port(out_port), priority(priority)
+    Rule(rid, sid, prefix, HSA::translate(prefix), in_port, out_port, priority)
 {
-    in_header = HSA::translate(prefix);
-    out_header = getAvailableOutHeader(in_header);
+
+}
+
+Rule::Rule(int rid, int sid, string prefix, const Header &in_header, int in_port, int out_port, int priority) :
+    rid(rid), sid(sid), prefix(move(prefix)), in_port(in_port), out_port(out_port), priority(priority)
+{
+    in_hid = HeaderPool::instance().intern(in_header);
+    out_hid = HeaderPool::instance().intern(getAvailableOutHeader(in_header));
 }
 
-int Rule::getSID()
+int Rule::getSID() const
 {
     return sid;
 }
     
-int Rule::getInPort()
+int Rule::getInPort() const
 {
     return in_port;
 }
 
-int Rule::getOutPort()
+int Rule::getOutPort() const
 {
     return out_port;
 }
+
+bool Rule::isPrefix() const
+{
+    return HeaderPool::instance().isPrefix(in_hid) && HeaderPool::instance().isPrefix(out_hid);
+}
      
-dynbitset Rule::getInHeader()
+const Header& Rule::getInHeader() const
 {
-    return in_header;
+    return HeaderPool::instance().get(in_hid);
 }
     
-dynbitset Rule::getOutHeader()
+const Header& Rule::getOutHeader() const
 {
-    return out_header;
+    return HeaderPool::instance().get(out_hid);
 }
 
-dynbitset Rule::getAvailableOutHeader(dynbitset &available_in_header)
+Header Rule::getAvailableOutHeader(const Header &available_in_header) const
 {
     return available_in_header;
 }
 
+int Rule::getInHeaderId() const
+{
+    return in_hid;
+}
+
+int Rule::getOutHeaderId() const
+{
+    return out_hid;
+}
+
+int Rule::getAvailableOutHeaderId(int available_in_hid) const
+{
+    // same as getAvailableOutHeader(), which has no set-field yet
+    return available_in_hid;
+}
+
+const Prefix& Rule::getInPrefix() const
+{
+    return HeaderPool::instance().getPrefix(in_hid);
+}
+
+const Prefix& Rule::getOutPrefix() const
+{
+    return HeaderPool::instance().getPrefix(out_hid);
+}
+
 RuleNode::RuleNode(int rid, int sid, string prefix, int in_port, int out_port, int priority) :
-    rule(Rule(rid, sid, prefix, in_port, out_port, priority))
+    rule(rid, sid, move(prefix), in_port, out_port, priority)
+{
+
+}
+
+RuleNode::RuleNode(int rid, int sid, string prefix, const Header &in_header, int in_port, int out_port, int priority) :
+    rule(rid, sid, move(prefix), in_header, in_port, out_port, priority)
 {
 
 }
@@ -49,25 +93,193 @@ Rule& RuleNode::getRule()
     return rule;
 }
 
+const Rule& RuleNode::getRule() const
+{
+    return rule;
+}
+
 vector<int>& RuleNode::getNexts()
 {
     return nexts;
 }
 
+const vector<int>& RuleNode::getNexts() const
+{
+    return nexts;
+}
+
 void RuleNode::addNext(int rid)
 {
     nexts.push_back(rid);
 }
 
-void RuleNode::addNextIfNotExists(int rid)
+DenseRuleGraph::DenseRuleGraph(const RuleGraph &rg)
 {
-    for(auto r : nexts) {
-        if(r == rid) {
-            return;
+    int n = rg.size();
+    auto r = make_shared<Rules>();
+    r->rids.reserve(n);
+    r->index.reserve(n);
+    for(auto &it : rg) {
+        r->index[it.first] = r->rids.size();
+        r->rids.push_back(it.first);
+    }
+
+    rows.reserve(n);
+    r->sids.resize(n);
+    r->in_ports.resize(n);
+    r->out_ports.resize(n);
+    r->in_hids.resize(n);
+    r->out_hids.resize(n);
+    for(int v = 0; v < n; v++) {
+        const RuleNode &node = rg.at(r->rids[v]);
+        int first = adj.size();
+        for(auto next : node.getNexts()) {
+            adj.push_back(r->index.at(next));
         }
+        rows.push_back(make_pair(first, (int)adj.size()));
+
+        const Rule &rule = node.getRule();
+        r->sids[v] = rule.getSID();
+        r->in_ports[v] = rule.getInPort();
+        r->out_ports[v] = rule.getOutPort();
+        r->in_hids[v] = rule.getInHeaderId();
+        r->out_hids[v] = rule.getOutHeaderId();
     }
-    
-    addNext(rid);
+    rules = r;
+}
+
+DenseRuleGraph::DenseRuleGraph(const DenseRuleGraph &g, const vector<ArenaNexts> &extra) :
+    rules(g.rules)
+{
+    size_t m = g.edges();
+    for(auto &vs : extra) {
+        m += vs.size();
+    }
+
+    adj.reserve(m);
+    rows.reserve(g.size());
+    for(int v = 0; v < g.size(); v++) {
+        Nexts base = g.getNexts(v);
+        int first = adj.size();
+        adj.insert(adj.end(), base.begin(), base.end());
+        adj.insert(adj.end(), extra[v].begin(), extra[v].end());
+        rows.push_back(make_pair(first, (int)adj.size()));
+    }
+}
+
+DenseRuleGraph::DenseRuleGraph(const DenseRuleGraph &g, const vector<int> &members, const vector<int> &local)
+{
+    int n = members.size();
+    const Rules &from = *g.rules;
+    auto r = make_shared<Rules>();
+    r->rids.resize(n);
+    r->index.reserve(n);
+    r->sids.resize(n);
+    r->in_ports.resize(n);
+    r->out_ports.resize(n);
+    r->in_hids.resize(n);
+    r->out_hids.resize(n);
+
+    rows.reserve(n);
+    for(int i = 0; i < n; i++) {
+        int v = members[i];
+        int first = adj.size();
+        for(auto w : g.getNexts(v)) {
+            adj.push_back(local[w]);
+        }
+        rows.push_back(make_pair(first, (int)adj.size()));
+
+        r->rids[i] = from.rids[v];
+        r->index[from.rids[v]] = i;
+        r->sids[i] = from.sids[v];
+        r->in_ports[i] = from.in_ports[v];
+        r->out_ports[i] = from.out_ports[v];
+        r->in_hids[i] = from.in_hids[v];
+        r->out_hids[i] = from.out_hids[v];
+    }
+    rules = r;
+}
+
+void DenseRuleGraph::getPrevs(vector<int> &offs, vector<int> &prevs) const
+{
+    int n = size();
+    offs.assign(n + 1, 0);
+    for(int u = 0; u < n; u++) {
+        for(auto v : getNexts(u)) {
+            offs[v + 1]++;
+        }
+    }
+    for(int v = 0; v < n; v++) {
+        offs[v + 1] += offs[v];
+    }
+
+    // offs[v] runs to the end of the prevs of 'v' while they are filled in,
+    // which is where those of 'v' + 1 start
+    prevs.resize(adj.size() - nstale);
+    for(int u = 0; u < n; u++) {
+        for(auto v : getNexts(u)) {
+            prevs[offs[v]++] = u;
+        }
+    }
+    for(int v = n; v > 0; v--) {
+        offs[v] = offs[v - 1];
+    }
+    offs[0] = 0;
+}
+
+void DenseRuleGraph::setRule(int v, int rid, const Rule &rule)
+{
+    Rules &r = *rules;
+    if(v == size()) {
+        r.rids.push_back(rid);
+        r.sids.push_back(rule.getSID());
+        r.in_ports.push_back(rule.getInPort());
+        r.out_ports.push_back(rule.getOutPort());
+        r.in_hids.push_back(rule.getInHeaderId());
+        r.out_hids.push_back(rule.getOutHeaderId());
+    }
+    else {
+        r.rids[v] = rid;
+        r.sids[v] = rule.getSID();
+        r.in_ports[v] = rule.getInPort();
+        r.out_ports[v] = rule.getOutPort();
+        r.in_hids[v] = rule.getInHeaderId();
+        r.out_hids[v] = rule.getOutHeaderId();
+    }
+    r.index[rid] = v;
+    setNexts(v, vector<int>());
+}
+
+void DenseRuleGraph::removeRule(int v)
+{
+    rules->index.erase(rules->rids[v]);
+    rules->rids[v] = -1;
+    setNexts(v, vector<int>());
+}
+
+void DenseRuleGraph::setNexts(int v, const vector<int> &nexts)
+{
+    // a graph sharing the rules of another has no rows yet for the rules added to it
+    if((int)rows.size() <= v) {
+        rows.resize(size(), make_pair(0, 0));
+    }
+    nstale += rows[v].second - rows[v].first;
+    rows[v] = make_pair((int)adj.size(), (int)(adj.size() + nexts.size()));
+    adj.insert(adj.end(), nexts.begin(), nexts.end());
+}
+
+size_t DenseRuleGraph::bytes() const
+{
+    size_t b = sizeof(pair<int, int>) * rows.capacity() + sizeof(int) * adj.capacity();
+    if(!rules) return b;
+
+    // the rule attributes, shared or not
+    const Rules &r = *rules;
+    b += sizeof(int) * (r.rids.capacity() + r.sids.capacity() + r.in_ports.capacity() + r.out_ports.capacity() +
+                        r.in_hids.capacity() + r.out_hids.capacity());
+    // buckets plus one node per entry
+    b += sizeof(void*) * r.index.bucket_count() + (sizeof(void*) + 2 * sizeof(int)) * r.index.size();
+    return b;
 }
 
 SwitchNode::SwitchNode(int sid, int sidx) :
@@ -76,12 +288,12 @@ SwitchNode::SwitchNode(int sid, int sidx) :
 
 }
     
-int SwitchNode::getSID()
+int SwitchNode::getSID() const
 {
     return sid;
 }
 
-int SwitchNode::getSIdx()
+int SwitchNode::getSIdx() const
 {
     return sidx;
 }
@@ -91,11 +303,21 @@ vector<int>& SwitchNode::getNeighbors()
     return neighbors;
 }
 
+const vector<int>& SwitchNode::getNeighbors() const
+{
+    return neighbors;
+}
+
 vector<int>& SwitchNode::getRules()
 {
     return rules;
 }
 
+const vector<int>& SwitchNode::getRules() const
+{
+    return rules;
+}
+
 void SwitchNode::addNeighbor(int sid)
 {
     neighbors.push_back(sid);
@@ -7,18 +7,42 @@
 #include <string>
 #include <vector>
 #include <queue>
+#include <set>
+#include <map>
+#include <memory>
+#include <limits>
+#include <algorithm>
 #include <unordered_map>
-#include <boost/dynamic_bitset.hpp>
+
+
+#include "ternary.hpp"
+#include "arena.hpp"
 
 using namespace std;
 
-#define dynbitset boost::dynamic_bitset<>
+// width of rule headers in ternary digits (32 for IPv4 prefixes)
+#ifndef HEADER_BITS
+#define HEADER_BITS 32
+#endif
 
-#define MAX_NUM_SWITCH 1000
 #define INF (numeric_limits<int>::max())
 #define SID_OF_MASKLEN -1
 #define PORT_HOST 1000
 
+// rule header with a compile-time width
+typedef Ternary<HEADER_BITS> Header;
+static_assert(HEADER_BITS >= 32, "rule headers must hold an IPv4 prefix");
+
+// test header with a runtime width (number of monitoring bits)
+typedef Ternary<0> TestHeader;
+
+// compact form of a rule header that is a pure IPv4 prefix
+struct Prefix {
+    uint32_t value;     // network address with host bits cleared
+    uint32_t mask;      // netmask, kept to test overlap without shifting
+    int len;            // prefix length, -1 for the empty set
+};
+
 class RuleNode;
 class SwitchNode;
 
@@ -32,18 +56,52 @@ typedef unordered_map<int, SwitchNode> SwitchGraph;
 typedef unordered_map<int, set<int>> SwitchGraphAlpha;
 typedef unordered_map<int, set<int>> SwitchGraphBeta;
 
-// help to build beta
-typedef int SwitchGraphMatrix[MAX_NUM_SWITCH][MAX_NUM_SWITCH];
+// 0/1 adjacency matrix over switches 0..n-1, packed 64 per word
+class SwitchGraphMatrix {
+public:
+    SwitchGraphMatrix(int n=0) : n(n), words((n + 63) / 64), bits((size_t)n * words, 0) {}
+
+    int size() const { return n; }
+    bool get(int u, int v) const { return bits[u * words + v / 64] >> (v % 64) & 1; }
+    void set(int u, int v, bool b) {
+        uint64_t &w = bits[u * words + v / 64];
+        w = b ? (w | (uint64_t)1 << (v % 64)) : (w & ~((uint64_t)1 << (v % 64)));
+    }
+
+    // row 'u' as words, bit 'v' of the row is get(u, v)
+    const uint64_t* row(int u) const { return bits.data() + u * words; }
+
+private:
+    int n;
+    size_t words;
+    vector<uint64_t> bits;
+};
+
+// nexts of a rule under construction, in the arena of path cover
+typedef vector<int, ArenaAllocator<int>> ArenaNexts;
+
+// rules (dense indices) a matched closure edge 'src' -> 'v' stands for,
+// after 'src' up to 'v', empty for unmatched sources
+typedef vector<ArenaNexts> TransPath;
 
-// path in transitive closure
-typedef unordered_map<int, unordered_map<int, int>> TransPath;
+// reporters of a targets set, in the scratch arena of the caller if any
+typedef set<int, less<int>, ArenaAllocator<int>> ReporterSet;
 
-// rule id -> available header in trasitive closure and maximum matching
-typedef unordered_map<int, dynbitset> HeaderMap;
+// rule id -> id of available header in trasitive closure and maximum matching
+typedef unordered_map<int, int> HeaderIdMap;
 
 // non-disjoint rule path set finally found
 typedef vector<vector<int>> PathSet;
 
+// rules and edges (rule ids) added to or removed from a rule graph, the edges
+// from or to added and removed rules go with them and need not be listed
+struct RuleGraphDelta {
+    vector<int> added_rules;
+    vector<int> removed_rules;
+    vector<pair<int, int>> added_edges;     // (from, to)
+    vector<pair<int, int>> removed_edges;
+};
+
 // targets set derived from rule path
 typedef set<vector<int>> TargetsSet;
 
@@ -63,25 +121,38 @@ typedef map<Color, vector<int>> CompactColoring;
 typedef unordered_map<int, Color> Assignments;
 
 // switch id -> test header for per-rule test
-typedef unordered_map<int, dynbitset> SwitchTestHeaders;
+typedef unordered_map<int, TestHeader> SwitchTestHeaders;
 
 // rule path -> <packet header, test header> (for non-single path)
-typedef map<vector<int>, dynbitset> PathPacketHeaders;
-typedef map<vector<int>, dynbitset> PathTestHeaders;
+typedef map<vector<int>, Header> PathPacketHeaders;
+typedef map<vector<int>, TestHeader> PathTestHeaders;
 
 class Rule {
 public:
     Rule()=default;
     Rule(int rid, int sid, string prefix, int in_port, int out_port, int priority);
+    // with 'prefix' already translated, e.g. from a binary topology
+    Rule(int rid, int sid, string prefix, const Header &in_header, int in_port, int out_port, int priority);
 
     // getter
-    int getSID();
-    int getInPort();
-    int getOutPort();
+    int getSID() const;
+    int getInPort() const;
+    int getOutPort() const;
+    bool isPrefix() const;
      
-    dynbitset getInHeader();
-    dynbitset getOutHeader();
-    dynbitset getAvailableOutHeader(dynbitset &available_in_header);
+    // headers live in HeaderPool, the references stay valid
+    const Header& getInHeader() const;
+    const Header& getOutHeader() const;
+    Header getAvailableOutHeader(const Header &available_in_header) const;
+
+    // ids of the headers in HeaderPool
+    int getInHeaderId() const;
+    int getOutHeaderId() const;
+    int getAvailableOutHeaderId(int available_in_hid) const;
+
+    // compact form of the headers, kept by HeaderPool, valid only if isPrefix()
+    const Prefix& getInPrefix() const;
+    const Prefix& getOutPrefix() const;
 
 private:
     int rid;
@@ -92,38 +163,123 @@ private:
     int priority;
     
     // split header into in and out to support set-field
-    dynbitset in_header;
-    dynbitset out_header;
+    // (interned in HeaderPool, shared by all rules with the same header)
+    int in_hid;
+    int out_hid;
 };
 
 class RuleNode {
 public:
     RuleNode()=default;
     RuleNode(int rid, int sid, string prefix, int in_port, int out_port, int priority);
+    RuleNode(int rid, int sid, string prefix, const Header &in_header, int in_port, int out_port, int priority);
 
     // getter
     Rule& getRule();
+    const Rule& getRule() const;
     vector<int>& getNexts();
+    const vector<int>& getNexts() const;
     
     // setter
     void addNext(int rid);
-    void addNextIfNotExists(int rid);
 
 private:
     Rule rule;
     vector<int> nexts;
 };
 
+/*
+ * Rule graph frozen for path cover, in compressed sparse rows.
+ *
+ * Rules are renumbered 0..N-1 in the iteration order of the RuleGraph, so
+ * a loop over the indices visits rules as a loop over the RuleGraph would.
+ * Rule attributes sit in flat arrays, and getRID() maps an index back to
+ * its rule id for output.
+ *
+ * A graph is immutable once built. Graphs derived from another one, e.g.
+ * its transitive closure, share the rule attributes and own only their
+ * edges, and the RuleGraph it was frozen from is left as it was.
+ */
+class DenseRuleGraph {
+public:
+    // [begin, end) of the nexts of a rule
+    struct Nexts {
+        const int *first;
+        const int *last;
+        const int* begin() const { return first; }
+        const int* end() const { return last; }
+        size_t size() const { return last - first; }
+    };
+
+    DenseRuleGraph()=default;
+    explicit DenseRuleGraph(const RuleGraph &rg);
+    // same rules as 'g' with the nexts of 'g' followed by 'extra', e.g. a transitive closure
+    DenseRuleGraph(const DenseRuleGraph &g, const vector<ArenaNexts> &extra);
+    // the rules 'members' of 'g' with all their nexts among them, e.g. a component, where
+    // members[i] becomes i == local[members[i]]
+    DenseRuleGraph(const DenseRuleGraph &g, const vector<int> &members, const vector<int> &local);
+
+    int size() const { return rules ? rules->rids.size() : 0; }
+    // edges, with the stale ones setNexts() and removeRule() left behind
+    size_t edges() const { return adj.size(); }
+    size_t stale() const { return nstale; }
+    size_t bytes() const;
+
+    Nexts getNexts(int v) const { return Nexts{adj.data() + rows[v].first, adj.data() + rows[v].second}; }
+    // position in 0..edges()-1 of an edge in the nexts of some rule
+    size_t getEdgeIndex(const int *next) const { return next - adj.data(); }
+    // the rules with 'v' in their nexts are prevs[offs[v], offs[v + 1])
+    void getPrevs(vector<int> &offs, vector<int> &prevs) const;
+
+    int getRID(int v) const { return rules->rids[v]; }
+    int getIndex(int rid) const { return rules->index.at(rid); }
+    bool hasRID(int rid) const { return rules && rules->index.count(rid); }
+    int getSID(int v) const { return rules->sids[v]; }
+    int getInPort(int v) const { return rules->in_ports[v]; }
+    int getOutPort(int v) const { return rules->out_ports[v]; }
+    int getInHeaderId(int v) const { return rules->in_hids[v]; }
+    int getOutHeaderId(int v) const { return rules->out_hids[v]; }
+    // same as Rule::getAvailableOutHeaderId()
+    int getAvailableOutHeaderId(int v, int available_in_hid) const { return available_in_hid; }
+
+    // 'v', which is size() or a removed rule, becomes rule 'rid' with no nexts;
+    // graphs derived from this one share its rules and see the change
+    void setRule(int v, int rid, const Rule &rule);
+    // 'v' is left with no rule id and no nexts, its edges go stale
+    void removeRule(int v);
+    // nexts of 'v' replaced, the old ones go stale
+    void setNexts(int v, const vector<int> &nexts);
+
+private:
+    vector<pair<int, int>> rows;    // nexts of v are adj[rows[v].first, rows[v].second)
+    vector<int> adj;
+    size_t nstale = 0;
+
+    struct Rules {
+        vector<int> rids;
+        unordered_map<int, int> index;  // rule id -> v
+        vector<int> sids;
+        vector<int> in_ports;
+        vector<int> out_ports;
+        vector<int> in_hids;
+        vector<int> out_hids;
+    };
+    // shared with graphs derived from this one
+    shared_ptr<Rules> rules;
+};
+
 class SwitchNode {
 public:
     SwitchNode()=default;
     SwitchNode(int sid, int sidx);
 
     // getter
-    int getSID();
-    int getSIdx();
+    int getSID() const;
+    int getSIdx() const;
     vector<int>& getNeighbors();
+    const vector<int>& getNeighbors() const;
     vector<int>& getRules();
+    const vector<int>& getRules() const;
 
     // setter
     void addNeighbor(int sid);
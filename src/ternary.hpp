@@ -0,0 +1,69 @@
+#ifndef TERNARY_H
+#define TERNARY_H
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+/*
+ * Packed ternary header with N digits.
+ *
+ * Each digit is kept as one bit in two planes, 'hi' (the digit may be 1) and
+ * 'lo' (the digit may be 0), which is the same encoding HSA has always used:
+ *   '-' = (0, 0), '0' = (0, 1), '1' = (1, 0), 'x' = (1, 1)
+ * Digit i lives in bit (i % 64) of word (i / 64), little endian as before.
+ *
+ * The storage is a plain array sized at compile time, so a header is copied
+ * as a couple of machine words and never touches the heap. Ternary<0> is the
+ * generic fallback whose width is only known at runtime (e.g. test headers,
+ * whose width is the number of monitoring bits).
+ */
+template<size_t N>
+class Ternary {
+public:
+    static const size_t WORDS = (N + 63) / 64;
+
+    Ternary() : lo(), hi() {}
+
+    size_t size() const { return N; }
+    size_t words() const { return WORDS; }
+
+    // valid bits of the last word
+    uint64_t tail() const { return (N % 64) ? ((uint64_t)1 << (N % 64)) - 1 : ~(uint64_t)0; }
+
+    bool operator==(const Ternary &o) const
+    {
+        for(size_t w = 0; w < WORDS; w++) {
+            if(lo[w] != o.lo[w] || hi[w] != o.hi[w]) return false;
+        }
+        return true;
+    }
+    bool operator!=(const Ternary &o) const { return !(*this == o); }
+
+    uint64_t lo[WORDS];
+    uint64_t hi[WORDS];
+};
+
+template<>
+class Ternary<0> {
+public:
+    Ternary() : width(0) {}
+    explicit Ternary(size_t width) : width(width), lo((width + 63) / 64), hi((width + 63) / 64) {}
+
+    size_t size() const { return width; }
+    size_t words() const { return lo.size(); }
+
+    uint64_t tail() const { return (width % 64) ? ((uint64_t)1 << (width % 64)) - 1 : ~(uint64_t)0; }
+
+    bool operator==(const Ternary &o) const { return width == o.width && lo == o.lo && hi == o.hi; }
+    bool operator!=(const Ternary &o) const { return !(*this == o); }
+
+private:
+    size_t width;
+
+public:
+    std::vector<uint64_t> lo;
+    std::vector<uint64_t> hi;
+};
+
+#endif
@@ -0,0 +1,123 @@
+#include "threads.hpp"
+
+static thread_local int slot = 0;
+
+ThreadPool::ThreadPool() : job(nullptr), job_n(0), next(0), active(0), generation(0), stopping(false)
+{
+
+}
+
+ThreadPool::~ThreadPool()
+{
+    stop();
+}
+
+void ThreadPool::resize(int n)
+{
+    stop();
+    stopping = false;
+    for(int i = 1; i < n; i++) {
+        workers.push_back(thread(&ThreadPool::work, this, i));
+    }
+}
+
+int ThreadPool::size()
+{
+    return workers.size() + 1;
+}
+
+void ThreadPool::stop()
+{
+    {
+        lock_guard<mutex> lock(mtx);
+        stopping = true;
+    }
+    wake.notify_all();
+    for(auto &w : workers) {
+        w.join();
+    }
+    workers.clear();
+}
+
+// take items of the current job until none is left
+void ThreadPool::drain()
+{
+    for(size_t i = next++; i < job_n; i = next++) {
+        try {
+            (*job)(i);
+        }
+        catch(...) {
+            lock_guard<mutex> lock(mtx);
+            if(!error) error = current_exception();
+        }
+    }
+}
+
+bool ThreadPool::busy()
+{
+    lock_guard<mutex> lock(mtx);
+    return job != nullptr;
+}
+
+int ThreadPool::worker()
+{
+    return slot;
+}
+
+void ThreadPool::work(int id)
+{
+    slot = id;
+    unsigned long seen = 0;
+    while(true) {
+        {
+            unique_lock<mutex> lock(mtx);
+            wake.wait(lock, [&]{ return stopping || generation != seen; });
+            if(stopping) return;
+            seen = generation;
+        }
+
+        drain();
+
+        lock_guard<mutex> lock(mtx);
+        if(--active == 0) done.notify_one();
+    }
+}
+
+void ThreadPool::run(size_t n, const function<void(size_t)> &fn)
+{
+    bool inline_run = workers.empty() || n <= 1;
+    if(!inline_run) {
+        // the pool runs one job at a time, another run() of the caller's
+        // own job or of a concurrent caller goes inline
+        lock_guard<mutex> lock(mtx);
+        inline_run = (job != nullptr);
+        if(!inline_run) job = &fn;
+    }
+    if(inline_run) {
+        for(size_t i = 0; i < n; i++) {
+            fn(i);
+        }
+        return;
+    }
+
+    {
+        lock_guard<mutex> lock(mtx);
+        job_n = n;
+        next = 0;
+        active = workers.size();
+        error = nullptr;
+        generation++;
+    }
+    wake.notify_all();
+
+    drain();
+
+    unique_lock<mutex> lock(mtx);
+    done.wait(lock, [&]{ return active == 0; });
+    job = nullptr;
+    if(error) {
+        exception_ptr err = error;
+        error = nullptr;
+        rethrow_exception(err);
+    }
+}
@@ -0,0 +1,69 @@
+#ifndef THREADS_H
+#define THREADS_H
+
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+#include "structs.hpp"
+
+/*
+ * Fixed pool of worker threads shared by the parallel phases.
+ *
+ * run(n, fn) calls fn(i) for every i in [0, n) and returns once all calls
+ * are done. The calling thread takes part, so a pool of size 1 runs
+ * everything inline. Items are handed out one at a time, so a few large
+ * items do not hold up the rest. The first exception thrown by fn is
+ * rethrown from run() after all the other items have finished. A run() while the
+ * pool is busy, from inside fn or from another thread, runs inline.
+ *
+ * Inside fn, worker() tells which thread runs it, 0 (the caller) up to
+ * size() - 1, so per-thread scratch can be indexed by it.
+ */
+class ThreadPool {
+public:
+    ThreadPool(const ThreadPool&)=delete;
+    ThreadPool& operator=(const ThreadPool&)=delete;
+    static ThreadPool& instance() {
+        static ThreadPool pool;
+        return pool;
+    }
+
+    // number of threads including the caller, at least 1
+    void resize(int n);
+    int size();
+
+    void run(size_t n, const function<void(size_t)> &fn);
+
+    // a job is running, so a run() now would go inline
+    bool busy();
+
+    // index of the calling thread in the pool
+    static int worker();
+
+private:
+    ThreadPool();
+    ~ThreadPool();
+
+    void work(int id);
+    void drain();
+    void stop();
+
+    vector<thread> workers;
+    mutex mtx;
+    condition_variable wake;    // a job is posted or the pool stops
+    condition_variable done;    // the last worker left the job
+
+    const function<void(size_t)> *job;
+    size_t job_n;
+    std::atomic<size_t> next;
+    int active;                 // workers still in the current job
+    unsigned long generation;   // bumped for each job
+    bool stopping;
+    exception_ptr error;        // first one thrown by the current job
+};
+
+#endif
@@ -1,18 +1,12 @@
 #include "core.hpp"
 
-void TopoSort(RuleGraph &rg, vector<int> &topoorder)
+void TopoSort(const DenseRuleGraph &g, vector<int> &topoorder)
 {
     // get indegree
-    unordered_map<int, int> indegree;
-    
-    for(auto it : rg) {
-        int r = it.first;
-        indegree[r] = 0;
-    }
+    vector<int> indegree(g.size(), 0);
 
-    for(auto it : rg) {
-        int u = it.first;
-        for(auto v : rg.at(u).getNexts()) {
+    for(int u = 0; u < g.size(); u++) {
+        for(auto v : g.getNexts(u)) {
             indegree[v]++;
         }
     }
@@ -20,8 +14,7 @@ void TopoSort(RuleGraph &rg, vector<int> &topoorder)
     // start
     queue<int> q;
 
-    for(auto it : rg) {
-        int r = it.first;
+    for(int r = 0; r < g.size(); r++) {
         if(indegree[r] == 0) {
             q.push(r);
         }
@@ -33,7 +26,7 @@ void TopoSort(RuleGraph &rg, vector<int> &topoorder)
 
         topoorder.push_back(u);
 
-        for(auto v : rg.at(u).getNexts()) {
+        for(auto v : g.getNexts(u)) {
             indegree[v]--;
             if(indegree[v] == 0) {
                 q.push(v);
@@ -0,0 +1,89 @@
+#include "trie.hpp"
+
+RuleTrie::RuleTrie()
+{
+    clear();
+}
+
+void RuleTrie::clear()
+{
+    nodes.clear();
+    next.clear();
+    newNode();  // root
+}
+
+int RuleTrie::newNode()
+{
+    nodes.push_back(Node{{-1, -1, -1}, -1});
+    return nodes.size() - 1;
+}
+
+// lowest digit of 'h' that is not 'x', or -1 if all of them are
+static int LowestFixed(const Header &h)
+{
+    for(size_t w = 0; w < h.words(); w++) {
+        uint64_t valid = (w + 1 < h.words()) ? ~(uint64_t)0 : h.tail();
+        uint64_t fixed = ~(h.lo[w] & h.hi[w]) & valid;
+        if(fixed) {
+            return 64 * w + __builtin_ctzll(fixed);
+        }
+    }
+
+    return -1;
+}
+
+void RuleTrie::insert(const Header &h, int idx)
+{
+    int u = 0;
+    int low = LowestFixed(h);
+    for(int d = (int)h.size() - 1; d >= low && d >= 0; d--) {
+        bool hi = h.hi[d / 64] >> (d % 64) & 1;
+        bool lo = h.lo[d / 64] >> (d % 64) & 1;
+        if(!hi && !lo) return;  // empty header matches nothing
+
+        int c = (hi && lo) ? 2 : hi;
+        if(nodes[u].child[c] == -1) {
+            int v = newNode();
+            nodes[u].child[c] = v;
+        }
+        u = nodes[u].child[c];
+    }
+
+    if((int)next.size() <= idx) {
+        next.resize(idx + 1, -1);
+    }
+    next[idx] = nodes[u].head;
+    nodes[u].head = idx;
+}
+
+void RuleTrie::match(const Header &h, vector<uint64_t> &mask)
+{
+    // an empty digit anywhere in 'h' matches nothing
+    for(size_t w = 0; w < h.words(); w++) {
+        uint64_t valid = (w + 1 < h.words()) ? ~(uint64_t)0 : h.tail();
+        if(~(h.lo[w] | h.hi[w]) & valid) return;
+    }
+
+    stack.clear();
+    stack.push_back(0);
+    stack.push_back((int)h.size() - 1);
+
+    while(!stack.empty()) {
+        int d = stack.back(); stack.pop_back();
+        int u = stack.back(); stack.pop_back();
+
+        // all remaining digits of the stored headers are 'x'
+        for(int idx = nodes[u].head; idx != -1; idx = next[idx]) {
+            mask[idx / 64] |= (uint64_t)1 << (idx % 64);
+        }
+
+        if(d < 0) continue;
+
+        bool hi = h.hi[d / 64] >> (d % 64) & 1;
+        bool lo = h.lo[d / 64] >> (d % 64) & 1;
+        const int *child = nodes[u].child;
+        if(lo && child[0] != -1) { stack.push_back(child[0]); stack.push_back(d - 1); }
+        if(hi && child[1] != -1) { stack.push_back(child[1]); stack.push_back(d - 1); }
+        if((hi || lo) && child[2] != -1) { stack.push_back(child[2]); stack.push_back(d - 1); }
+    }
+}
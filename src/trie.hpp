@@ -0,0 +1,39 @@
+#ifndef TRIE_H
+#define TRIE_H
+
+#include "structs.hpp"
+
+/*
+ * Ternary trie over rule headers, walked from the highest digit down.
+ *
+ * A header is stored at the node where all its remaining digits are 'x', so
+ * a prefix sits at depth = prefix length. A query digit '0' follows the '0'
+ * and 'x' children, '1' follows '1' and 'x', and 'x' follows all three, so a
+ * query only visits the headers it can match.
+ */
+class RuleTrie {
+public:
+    RuleTrie();
+
+    void clear();
+
+    // store 'h' under the caller's index 'idx' (e.g. the position of a rule)
+    void insert(const Header &h, int idx);
+
+    // set bit 'idx' of 'mask' for every stored header matchable with 'h'
+    void match(const Header &h, vector<uint64_t> &mask);
+
+private:
+    struct Node {
+        int child[3];   // '0', '1', 'x'
+        int head;       // first index stored here, chained through 'next'
+    };
+
+    int newNode();
+
+    vector<Node> nodes;
+    vector<int> next;       // idx -> next idx stored at the same node
+    vector<int> stack;      // (node, digit) pairs during a match
+};
+
+#endif
@@ -1,14 +1,19 @@
 #include "core.hpp"
 
+#include "unistd.h"
+
 void usage()
 {
-    printf("[-] Usage: ./tss -f <topofile>|<tssfile> -m <mode>\n"
-           "[ ] <topofile>: filename under /data/topo/ (with mode store)\n"
-           "[ ] <tssfile>: filename under /data/tss/ (with mode greedy|compact|compare)\n"
-           "[ ] <mode>: store|greedy|compact|compare\n");
+    printf("[-] Usage: ./tss -f <topofile>|<tssfile> -m <mode> [-j <threads>] [-z] [-H]\n"
+           "[ ] <topofile>: filename under /data/topo/, .topo, .topo.gz or .btopo (with mode store)\n"
+           "[ ] <tssfile>: filename under /data/tss/, .tss or .tss.gz (with mode greedy|compact|compare)\n"
+           "[ ] <mode>: store|greedy|compact|compare\n"
+           "[ ] <threads>: number of threads (1 by default)\n"
+           "[ ] -z: write a gzipped .tss.gz (with mode store)\n"
+           "[ ] -H: back the scratch arenas with huge pages\n");
 }
 
-void store(string name)
+void store(string name, string gz)
 {
     /* load topo */ 
     SwitchGraph sg;
@@ -17,23 +22,21 @@ void store(string name)
 
     /* path cover (hopcroftkarp) */
     PathSet ps;
-    PathCover(rg, ps, true);
+    PathCover(rg, ps, "hopcroft-karp", 0);
     
     /* get and persist targets set */
     TargetsSet tss;
-    for(auto p : ps) {
-        vector<int> targets = GetTargets(rg, p);
-        tss.insert(targets);
+    for(auto &p : ps) {
+        tss.insert(GetTargets(rg, p));
     }
 
-    for(auto it : sg) {
+    for(auto &it : sg) {
         int s = it.first;
-        vector<int> targets = {s};
-        tss.insert(targets);
+        tss.insert(vector<int>{s});
     }
 
-    name.replace(name.end()-5, name.end(), "");
-    IO::instance().StoreTargetsSet(name + ".tss", sg, tss);
+    name = IO::Stem(name);     // remove ".topo", ".topo.gz" or ".btopo"
+    IO::instance().StoreTargetsSet(name + ".tss" + gz, sg, tss);
 }
 
 void assign(string name, string mode)
@@ -71,19 +74,26 @@ int main(int argc, char** argv)
 {
     string name;
     string mode;
+    int threads = 1;
+    string gz;
     
     int opt;
-    while((opt = getopt(argc, argv, "f:m:")) != -1) {
+    while((opt = getopt(argc, argv, "f:m:j:zH")) != -1) {
         switch(opt) {
             case 'f': name = optarg; break;
             case 'm': mode = optarg; break;
+            case 'j': threads = atoi(optarg); break;
+            case 'z': gz = ".gz"; break;
+            case 'H': Arena::hugepages(true); break;
             default: usage(); return 0;
         }
     }
     
+    if(threads > 1) { ThreadPool::instance().resize(threads); }
+
     try {
         if(mode == "store") {
-            store(name);
+            store(name, gz);
         }
         else if(mode == "compare") {
             compare(name);